@@ -168,39 +168,280 @@ template <class T> T AbstractGroup<T>::CascadeScalarMultiply(const Element &x, c
 	return result;
 }
 
-template <class Element, class Iterator> Element GeneralCascadeMultiplication(const AbstractGroup<Element> &group, Iterator begin, Iterator end)
+// sets digits so that e is the sum of digits[i]*2^i, where each nonzero digit is odd and
+// is followed by at least w-1 zero digits, and is less than 2^w (sliding window),
+// or less than 2^(w-1) in absolute value if allowNegative is set (width-w NAF)
+inline void RecodeExponent(std::vector<int> &digits, const Integer &e, unsigned int w, bool allowNegative)
 {
-	if (end-begin == 1)
-		return group.ScalarMultiply((*begin).second, (*begin).first);
-	else if (end-begin == 2)
-		return group.CascadeScalarMultiply((*begin).second, (*begin).first, (*(begin+1)).second, (*(begin+1)).first);
-	else
+	const unsigned int expLen = e.BitCount();
+	digits.assign(expLen+1, 0);
+	unsigned int i=0, j;
+	int carry = 0;
+
+	while (i < expLen || carry)
+	{
+		if (int(e.GetBit(i)) == carry)
+		{
+			i++;	// digit is 0, carry is unchanged
+			continue;
+		}
+
+		int d = carry;
+		for (j=0; j<w; j++)
+			d += int(e.GetBit(i+j)) << j;
+		carry = 0;
+		if (allowNegative && d > (1 << (w-1)))
+		{
+			d -= 1 << w;
+			carry = 1;
+		}
+		digits[i] = d;
+		i += w;
+	}
+}
+
+// number of Add() calls to multiply a base by an expLen bit exponent, not counting doublings,
+// if a table of odd multiples is computed for each base and the window is w bits
+inline unsigned int InterleavedWindowCost(unsigned int expLen, unsigned int w, bool allowNegative)
+{
+	return (allowNegative ? (1 << (w-2)) : (1 << (w-1))) + expLen/(w+1);
+}
+
+inline unsigned int InterleavedWindowSize(unsigned int expLen, bool allowNegative)
+{
+	unsigned int w = allowNegative ? 2 : 1;
+	while (InterleavedWindowCost(expLen, w+1, allowNegative) < InterleavedWindowCost(expLen, w, allowNegative))
+		w++;
+	return w;
+}
+
+// number of Add() calls for count bases if exponents are cut into c bit windows, the first
+// addition to each bucket is free and summing the buckets takes two additions per bucket
+inline unsigned int BucketCost(unsigned int count, unsigned int expLen, unsigned int c, bool allowNegative)
+{
+	return (expLen+allowNegative+c-1)/c * (count + (allowNegative ? (1 << (c-1)) : (1 << c)));
+}
+
+// adds b to a, or sets a to b if a is still Zero()
+template <class Element> inline void AccumulateTo(const AbstractGroup<Element> &group, Element &a, bool &empty, const Element &b)
+{
+	if (empty)
 	{
-		Integer q, r;
-		Iterator last = end;
-		--last;
+		a = b;
+		empty = false;
+	}
+	else
+		group.Accumulate(a, b);
+}
 
-		std::make_heap(begin, end);
-		std::pop_heap(begin, end);
+template <class Element, class Iterator> Element InterleavedWindowMultiplication(const AbstractGroup<Element> &group, Iterator begin, Iterator end)
+{
+	const unsigned int count = end-begin;
+	const bool allowNegative = group.InversionIsFast();
+	std::vector<std::vector<int> > digits(count);
+	std::vector<std::vector<Element> > tables(count);
+	unsigned int i, j, expLen = 0;
 
-		while (!!(*begin).first)
+	for (i=0; i<count; i++, ++begin)
+	{
+		const Integer &e = (*begin).first;
+		const unsigned int w = InterleavedWindowSize(e.BitCount(), allowNegative);
+		RecodeExponent(digits[i], e, w, allowNegative);
+		expLen = STDMAX(expLen, (unsigned int)digits[i].size());
+
+		std::vector<Element> &table = tables[i];
+		table.resize(allowNegative ? (1 << (w-2)) : (1 << (w-1)));
+		table[0] = (*begin).second;
+		if (table.size() > 1)
 		{
-			// (*last).first is largest exponent, (*begin).first is next largest
-			Integer::Divide(r, q, (*last).first, (*begin).first);
+			Element twice = group.Double(table[0]);
+			for (j=1; j<table.size(); j++)
+				table[j] = group.Add(table[j-1], twice);
+		}
+	}
+
+	Element result = group.Zero();
+	bool empty = true;
 
-			if (q == Integer::One())
-				group.Accumulate((*begin).second, (*last).second);	// avoid overhead of GeneralizedMultiplication()
+	for (int k=expLen-1; k>=0; k--)
+	{
+		if (!empty)
+			result = group.Double(result);
+
+		for (i=0; i<count; i++)
+		{
+			if ((unsigned int)k >= digits[i].size() || !digits[i][k])
+				continue;
+
+			const int d = digits[i][k];
+			if (d > 0)
+				AccumulateTo(group, result, empty, tables[i][(d-1)/2]);
+			else if (empty)
+				AccumulateTo(group, result, empty, group.Inverse(tables[i][(-d-1)/2]));
 			else
-				group.Accumulate((*begin).second, group.ScalarMultiply((*last).second, q));
+				group.Reduce(result, tables[i][(-d-1)/2]);
+		}
+	}
 
-			(*last).first = r;
+	return result;
+}
 
-			std::push_heap(begin, end);
-			std::pop_heap(begin, end);
+template <class Element, class Iterator> Element BucketMultiplication(const AbstractGroup<Element> &group, Iterator begin, Iterator end, unsigned int expLen, unsigned int c)
+{
+	const unsigned int count = end-begin;
+	const bool allowNegative = group.InversionIsFast();
+	const unsigned int windows = (expLen+allowNegative+c-1)/c;
+	const int half = 1 << (c-1);
+	std::vector<int> digits(count*windows);
+	unsigned int i, j, k;
+
+	Iterator it = begin;
+	for (i=0; i<count; i++, ++it)
+	{
+		const Integer &e = (*it).first;
+		int carry = 0;
+		for (k=0; k<windows; k++)
+		{
+			int d = carry;
+			for (j=0; j<c; j++)
+				d += int(e.GetBit(k*c+j)) << j;
+			carry = 0;
+			if (allowNegative && d > half)
+			{
+				d -= 2*half;
+				carry = 1;
+			}
+			digits[i*windows+k] = d;
 		}
+		assert(carry == 0);
+	}
+
+	std::vector<Element> buckets(allowNegative ? half : 2*half-1);
+	std::vector<bool> used(buckets.size());
+	Element result = group.Zero(), sum, total;
+	bool resultEmpty = true, sumEmpty, totalEmpty;
+
+	for (k=windows; k-- > 0; )
+	{
+		if (!resultEmpty)
+			for (j=0; j<c; j++)
+				result = group.Double(result);
+
+		std::fill(used.begin(), used.end(), false);
+		for (i=0, it=begin; i<count; i++, ++it)
+		{
+			const int d = digits[i*windows+k];
+			if (d > 0)
+			{
+				bool empty = !used[d-1];
+				AccumulateTo(group, buckets[d-1], empty, (*it).second);
+				used[d-1] = true;
+			}
+			else if (d < 0)
+			{
+				if (used[-d-1])
+					group.Reduce(buckets[-d-1], (*it).second);
+				else
+					buckets[-d-1] = group.Inverse((*it).second);
+				used[-d-1] = true;
+			}
+		}
+
+		// total = sum of (j+1)*buckets[j], as a sum of partial sums
+		sumEmpty = totalEmpty = true;
+		for (j=buckets.size(); j-- > 0; )
+		{
+			if (used[j])
+				AccumulateTo(group, sum, sumEmpty, buckets[j]);
+			if (!sumEmpty)
+				AccumulateTo(group, total, totalEmpty, sum);
+		}
+
+		if (!totalEmpty)
+			AccumulateTo(group, result, resultEmpty, total);
+	}
+
+	return result;
+}
+
+template <class Iterator> struct ExponentLess
+{
+	ExponentLess(Iterator begin) : begin(begin) {}
+	bool operator()(unsigned int i, unsigned int j) const
+		{return (*(begin+i)).first < (*(begin+j)).first;}
+	Iterator begin;
+};
+
+// replaces the largest exponent with its remainder modulo the next largest (Bos-Coster),
+// uses a heap of indices so elements are not copied, modifies the pairs in [begin, end)
+template <class Element, class Iterator> Element HeapMultiplication(const AbstractGroup<Element> &group, Iterator begin, Iterator end)
+{
+	std::vector<unsigned int> heap(end-begin);
+	for (unsigned int i=0; i<heap.size(); i++)
+		heap[i] = i;
+
+	ExponentLess<Iterator> less(begin);
+	std::make_heap(heap.begin(), heap.end(), less);
+	std::pop_heap(heap.begin(), heap.end(), less);
+
+	Integer q, r;
+	Iterator last = begin+heap.back(), next = begin+heap.front();
+
+	while (!!(*next).first)
+	{
+		// (*last).first is largest exponent, (*next).first is next largest
+		Integer::Divide(r, q, (*last).first, (*next).first);
+
+		if (q == Integer::One())
+			group.Accumulate((*next).second, (*last).second);	// avoid overhead of ScalarMultiply()
+		else
+			group.Accumulate((*next).second, group.ScalarMultiply((*last).second, q));
+
+		(*last).first.swap(r);
+
+		std::push_heap(heap.begin(), heap.end(), less);
+		std::pop_heap(heap.begin(), heap.end(), less);
+		last = begin+heap.back();
+		next = begin+heap.front();
+	}
+
+	return group.ScalarMultiply((*last).second, (*last).first);
+}
+
+template <class Element, class Iterator> Element GeneralCascadeMultiplication(const AbstractGroup<Element> &group, Iterator begin, Iterator end)
+{
+	const unsigned int count = end-begin;
+	if (count == 1)
+		return group.ScalarMultiply((*begin).second, (*begin).first);
+	else if (count == 2)
+		return group.CascadeScalarMultiply((*begin).second, (*begin).first, (*(begin+1)).second, (*(begin+1)).first);
 
-		return group.ScalarMultiply((*last).second, (*last).first);
+	const bool allowNegative = group.InversionIsFast();
+	unsigned int expLen = 0, interleavedCost = 0;
+	Iterator it;
+	for (it=begin; it!=end; ++it)
+	{
+		assert((*it).first.NotNegative());
+		const unsigned int bitCount = (*it).first.BitCount();
+		expLen = STDMAX(expLen, bitCount);
+		interleavedCost += InterleavedWindowCost(bitCount, InterleavedWindowSize(bitCount, allowNegative), allowNegative);
 	}
+
+	if (expLen == 0)
+		return group.Zero();
+
+	// with exponents this short most quotients are one, and the heap method needs about one Add() per pair
+	if (expLen < 2*BitPrecision(count))
+		return HeapMultiplication(group, begin, end);
+
+	unsigned int c = 1;
+	while (BucketCost(count, expLen, c+1, allowNegative) < BucketCost(count, expLen, c, allowNegative))
+		c++;
+
+	if (BucketCost(count, expLen, c, allowNegative) < interleavedCost)
+		return BucketMultiplication(group, begin, end, expLen, c);
+	else
+		return InterleavedWindowMultiplication(group, begin, end);
 }
 
 template <class Element>
@@ -294,8 +535,95 @@ void SimultaneousMultiplication(Iterator result, const AbstractGroup<Element> &g
 
 template <class T> T AbstractRing<T>::Exponentiate(const Element &base, const Integer &exponent) const
 {
+	assert(exponent.NotNegative());
+	const unsigned int expLen = exponent.BitCount();
+	if (expLen==0)
+		return One();
+
+	// left-to-right sliding window, powerTable[i] = base^(2*i+1)
+	const unsigned int w = (expLen <= 23 ? 1 : (expLen <= 79 ? 3 : (expLen <= 239 ? 4 : (expLen <= 671 ? 5 : 6))));
+	std::vector<Element> powerTable(1<<(w-1));
+
+	powerTable[0] = base;
+	if (w > 1)
+	{
+		Element square = Square(base);
+		for (unsigned int i=1; i<powerTable.size(); i++)
+			powerTable[i] = Multiply(powerTable[i-1], square);
+	}
+
 	Element result;
-	SimultaneousMultiplication(&result, MultiplicativeGroup(), base, &exponent, &exponent+1);
+	bool firstTime = true;
+	int i = expLen-1;
+
+	while (i >= 0)
+	{
+		if (!exponent.GetBit(i))
+		{
+			result = Square(result);
+			i--;
+			continue;
+		}
+
+		// find the longest window of at most w bits that starts and ends with a 1
+		int j = STDMAX(i-int(w)+1, 0);
+		while (!exponent.GetBit(j))
+			j++;
+
+		unsigned int window = 0;
+		for (int k=i; k>=j; k--)
+			window = 2*window + exponent.GetBit(k);
+
+		if (firstTime)
+		{
+			result = powerTable[window/2];
+			firstTime = false;
+		}
+		else
+		{
+			for (int k=i; k>=j; k--)
+				result = Square(result);
+			result = Multiply(result, powerTable[window/2]);
+		}
+		i = j-1;
+	}
+	return result;
+}
+
+template <class T> T AbstractRing<T>::FixedWindowExponentiate(const Element &base, const Integer &exponent, unsigned int expLen) const
+{
+	assert(exponent.NotNegative());
+	expLen = STDMAX(expLen, exponent.BitCount());
+	if (expLen==0)
+		return One();
+
+	// powerTable[i] = base^i
+	const unsigned int w = (expLen <= 24 ? 2 : (expLen <= 96 ? 3 : (expLen <= 320 ? 4 : (expLen <= 960 ? 5 : 6))));
+	std::vector<Element> powerTable(1<<w);
+
+	powerTable[0] = One();
+	powerTable[1] = base;
+	for (unsigned int i=2; i<powerTable.size(); i++)
+		powerTable[i] = Multiply(powerTable[i-1], base);
+
+	const unsigned int windows = (expLen+w-1)/w;
+	unsigned int window = 0;
+	int i, k;
+
+	for (k=w-1; k>=0; k--)
+		window = 2*window + exponent.GetBit((windows-1)*w+k);
+	Element result = powerTable[window];
+
+	for (i=windows-2; i>=0; i--)
+	{
+		window = 0;
+		for (k=w-1; k>=0; k--)
+		{
+			result = Square(result);
+			window = 2*window + exponent.GetBit(i*w+k);
+		}
+		result = Multiply(result, powerTable[window]);
+	}
 	return result;
 }
 
@@ -304,6 +632,55 @@ template <class T> T AbstractRing<T>::CascadeExponentiate(const Element &x, cons
 	return MultiplicativeGroup().CascadeScalarMultiply(x, e1, y, e2);
 }
 
+template <class T> void AbstractRing<T>::BatchInverse(Element *elements, unsigned int count) const
+{
+	BatchInversion(*this, elements, elements+count);
+}
+
+template <class Element, class Iterator> void BatchInversion(const AbstractRing<Element> &ring, Iterator begin, Iterator end, bool zeroForNonUnits)
+{
+	const unsigned int n = end-begin;
+	if (n == 0)
+		return;
+
+	// prefix[i] = product of the nonzero elements before element i
+	std::vector<Element> prefix(n);
+	Element product = ring.One();
+	unsigned int i;
+
+	for (i=0; i<n; i++)
+		if (!ring.Equal(*(begin+i), ring.Zero()))
+		{
+			prefix[i] = product;
+			product = ring.Multiply(product, *(begin+i));
+		}
+
+	bool invertible = zeroForNonUnits || ring.IsUnit(product);
+	Element inverse;
+	if (invertible)
+	{
+		inverse = ring.MultiplicativeInverse(product);
+		invertible = !ring.Equal(inverse, ring.Zero());
+	}
+
+	if (!invertible)
+	{
+		for (i=0; i<n; i++)
+			if (!ring.Equal(*(begin+i), ring.Zero()))
+				*(begin+i) = ring.MultiplicativeInverse(*(begin+i));
+		return;
+	}
+
+	// now inverse = 1/(product of the nonzero elements up to element i)
+	for (i=n; i--; )
+		if (!ring.Equal(*(begin+i), ring.Zero()))
+		{
+			prefix[i] = ring.Multiply(inverse, prefix[i]);
+			inverse = ring.Multiply(inverse, *(begin+i));
+			std::swap(*(begin+i), prefix[i]);
+		}
+}
+
 template <class Element, class Iterator> Element GeneralCascadeExponentiation(const AbstractRing<Element> &ring, Iterator begin, Iterator end)
 {
 	return GeneralCascadeMultiplication<Element>(ring.MultiplicativeGroup(), begin, end);
@@ -12,6 +12,7 @@ class Integer;
 // abcd = group.Add(group.Add(a,b), group.Add(c,d));
 // But this should be fine:
 // abcd = group.Add(a, group.Add(b, group.Add(c,d));
+// For the same reason an object may only be used by one thread at a time.
 
 template <class T> class AbstractGroup
 {
@@ -24,6 +25,8 @@ public:
 	virtual const Element& Zero() const =0;
 	virtual const Element& Add(const Element &a, const Element &b) const =0;
 	virtual const Element& Inverse(const Element &a) const =0;
+	// return true if Inverse() costs no more than Add(), so that algorithms may use negative digits
+	virtual bool InversionIsFast() const {return false;}
 
 	virtual const Element& Double(const Element &a) const;
 	virtual const Element& Subtract(const Element &a, const Element &b) const;
@@ -49,6 +52,14 @@ public:
 
 	virtual Element Exponentiate(const Element &a, const Integer &e) const;
 	virtual Element CascadeExponentiate(const Element &x, const Integer &e1, const Element &y, const Integer &e2) const;
+	// performs the same sequence of squarings and multiplications for all
+	// exponents of up to expLen bits, use this for secret exponents
+	virtual Element FixedWindowExponentiate(const Element &a, const Integer &e, unsigned int expLen) const;
+
+	// replaces each of elements[0..count) that isn't Zero() with its inverse, using one
+	// MultiplicativeInverse() and 3*(count-1) Multiply() calls (Montgomery's trick),
+	// or one MultiplicativeInverse() per element if some element isn't a unit
+	virtual void BatchInverse(Element *elements, unsigned int count) const;
 
 	virtual const AbstractGroup<T>& MultiplicativeGroup() const =0;
 };
@@ -98,6 +109,9 @@ template <class T> class RingWithDefaultMultiplicativeGroup : public AbstractRin
 public:
 	typedef T Element;
 	RingWithDefaultMultiplicativeGroup() : m_mg(*this) {}
+	// a copy's group must multiply in the copy, not in the ring it was copied from
+	RingWithDefaultMultiplicativeGroup(const RingWithDefaultMultiplicativeGroup &) : m_mg(*this) {}
+	RingWithDefaultMultiplicativeGroup & operator=(const RingWithDefaultMultiplicativeGroup &) {return *this;}
 	const AbstractGroup<T>& MultiplicativeGroup() const
 		{return m_mg;}
 private:
@@ -107,6 +121,9 @@ private:
 // ********************************************************
 
 // VC60 workaround: incomplete member template support
+// computes the sum of e*b for each pair (e, b) in [begin, end), using interleaved windows (Straus)
+// for a few pairs and buckets (Pippenger) for many, with negative digits if group.InversionIsFast(),
+// or Bos-Coster if the exponents are short, which may modify the pairs
 template <class Element, class Iterator>
 	Element GeneralCascadeMultiplication(const AbstractGroup<Element> &group, Iterator begin, Iterator end);
 template <class Element, class Iterator, class ConstIterator>
@@ -115,6 +132,10 @@ template <class Element, class Iterator>
 	Element GeneralCascadeExponentiation(const AbstractRing<Element> &ring, Iterator begin, Iterator end);
 template <class Element, class Iterator, class ConstIterator>
 	void SimultaneousExponentiation(Iterator result, const AbstractRing<Element> &ring, const Element &base, ConstIterator expBegin, ConstIterator expEnd);
+// BatchInverse() over any random access iterator, set zeroForNonUnits if ring.MultiplicativeInverse()
+// returns Zero() for non-units, to save an IsUnit() call
+template <class Element, class Iterator>
+	void BatchInversion(const AbstractRing<Element> &ring, Iterator begin, Iterator end, bool zeroForNonUnits = false);
 
 // ********************************************************
 
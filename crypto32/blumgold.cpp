@@ -120,8 +120,7 @@ unsigned int BlumGoldwasserPrivateKey::Decrypt(const byte *input, unsigned int c
 	Integer dq = a_exp_b_mod_c((q+1)/4, t, q-1);
 	Integer xp = a_exp_b_mod_c(xt%p, dp, p);
 	Integer xq = a_exp_b_mod_c(xt%q, dq, q);
-	bbs.current = CRT(xp, p, xq, q, u);
-	bbs.bitsLeft = bbs.maxBits;
+	bbs.SetState(CRT(xp, p, xq, q, u));
 
 	bbs.ProcessString(output, input+modulusLen, plainTextLength);
 	return plainTextLength;
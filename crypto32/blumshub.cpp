@@ -2,47 +2,129 @@
 
 #include "pch.h"
 #include "blumshub.h"
+#include "nbtheory.h"
 
 NAMESPACE_BEGIN(CryptoPP)
 
+// the low bits of a, up to a word of them
+static word LowWord(const Integer &a, unsigned int bits)
+{
+	word w = 0;
+	for (unsigned int i=0; i<(bits+7)/8; i++)
+		w |= word(a.GetByte(i)) << (8*i);
+	return w;
+}
+
 PublicBlumBlumShub::PublicBlumBlumShub(const Integer &n, const Integer &seed)
 	: modn(n),
 	  maxBits(BitPrecision(n.BitCount())-1)
 {
-	current = modn.Square(modn.Square(seed));
+	SetState(modn.Square(modn.Square(seed)));
+}
+
+void PublicBlumBlumShub::SetState(const Integer &x)
+{
+	current = x;
+	currentBits = LowWord(current, maxBits);
 	bitsLeft = maxBits;
 }
 
+word PublicBlumBlumShub::NextBits()
+{
+	current = modn.Square(current);
+	return LowWord(current, maxBits);
+}
+
 unsigned int PublicBlumBlumShub::GetBit()
 {
 	if (bitsLeft==0)
 	{
-		current = modn.Square(current);
+		currentBits = NextBits();
 		bitsLeft = maxBits;
 	}
 
-	return current.GetBit(--bitsLeft);
+	return (unsigned int)(currentBits >> --bitsLeft) & 1;
 }
 
 byte PublicBlumBlumShub::GetByte()
 {
-	byte b=0;
-	for (int i=0; i<8; i++)
-		b = (b << 1) | PublicBlumBlumShub::GetBit();
+	byte b;
+	PublicBlumBlumShub::GetBlock(&b, 1);
 	return b;
 }
 
+void PublicBlumBlumShub::GetBlock(byte *output, unsigned int size)
+{
+	while (size--)
+	{
+		unsigned int b = 0;
+		int needed = 8;
+		while (needed)
+		{
+			if (bitsLeft==0)
+			{
+				currentBits = NextBits();
+				bitsLeft = maxBits;
+			}
+
+			int n = STDMIN(needed, bitsLeft);
+			bitsLeft -= n;
+			needed -= n;
+			b = (b << n) | ((unsigned int)(currentBits >> bitsLeft) & ((1U << n) - 1));
+		}
+		*output++ = byte(b);
+	}
+}
+
+void PublicBlumBlumShub::ProcessString(byte *inoutString, unsigned int length)
+{
+	ProcessString(inoutString, inoutString, length);
+}
+
+void PublicBlumBlumShub::ProcessString(byte *outString, const byte *inString, unsigned int length)
+{
+	byte buf[256];
+	while (length)
+	{
+		unsigned int len = STDMIN(length, (unsigned int)sizeof(buf));
+		GetBlock(buf, len);
+		xorbuf(outString, inString, buf, len);
+		outString += len;
+		inString += len;
+		length -= len;
+	}
+	memset(buf, 0, sizeof(buf));
+}
+
 BlumBlumShub::BlumBlumShub(const Integer &p, const Integer &q, const Integer &seed)
 	: PublicBlumBlumShub(p*q, seed),
 	  p(p), q(q),
-	  x0(modn.Square(seed))
+	  x0(modn.Square(seed)),
+	  u(EuclideanMultiplicativeInverse(p, q)),
+	  modp(p), modq(q), mrp(p), mrq(q),
+	  x0p(mrp.ConvertIn(x0)), x0q(mrq.ConvertIn(x0)),
+	  xp(current%p), xq(current%q)
 {
 }
 
+word BlumBlumShub::NextBits()
+{
+	xp = modp.Square(xp);
+	xq = modq.Square(xq);
+
+	// the new state is xp + p*h, and only its low bits are needed
+	const Integer &h = modq.Multiply(u, (xq-xp)%q);
+	return LowWord(xp, maxBits) + LowWord(p, maxBits) * LowWord(h, maxBits);
+}
+
 void BlumBlumShub::Seek(unsigned long index)
 {
-	Integer e = a_exp_b_mod_c (2, ((index*8) / maxBits + 1), (p-1)*(q-1));
-	current = modn.Exponentiate(x0, e);
+	// x0 is a square, so its order divides (p-1)/2 and (q-1)/2
+	Integer i = (index*8) / maxBits + 1;
+	xp = mrp.ConvertOut(mrp.Exponentiate(x0p, a_exp_b_mod_c(2, i, (p-1)/2)));
+	xq = mrq.ConvertOut(mrq.Exponentiate(x0q, a_exp_b_mod_c(2, i, (q-1)/2)));
+
+	currentBits = LowWord(xp + p*modq.Multiply(u, (xq-xp)%q), maxBits);
 	bitsLeft = maxBits - int((index*8) % maxBits);
 }
 
@@ -17,14 +17,24 @@ public:
 
 	unsigned int GetBit();
 	byte GetByte();
+	// takes the bits of each square a run at a time, the output is the same as from GetBit()
+	void GetBlock(byte *output, unsigned int size);
 
 	byte ProcessByte(byte input)
 		{return (input ^ GetByte());}
+	void ProcessString(byte *inoutString, unsigned int length);
+	void ProcessString(byte *outString, const byte *inString, unsigned int length);
 
 protected:
+	// start a new run of bits at x
+	void SetState(const Integer &x);
+	// square the state and return the low maxBits bits of the new one
+	virtual word NextBits();
+
 	const ModularArithmetic modn;
 	const int maxBits;
-	Integer current;
+	Integer current;		// not kept up to date by BlumBlumShub
+	word currentBits;		// low maxBits bits of the state
 	int bitsLeft;
 
 	friend class BlumGoldwasserPublicKey;
@@ -41,8 +51,16 @@ public:
 	void Seek(unsigned long index);
 
 protected:
+	// squares mod p and mod q, and recombines only the low bits of the result
+	word NextBits();
+
 	const Integer p, q;
 	const Integer x0;
+	const Integer u;				// inverse of p mod q
+	const ModularArithmetic modp, modq;
+	const MontgomeryRepresentation mrp, mrq;
+	const Integer x0p, x0q;			// x0 mod p and mod q, in Montgomery representation
+	Integer xp, xq;					// the state mod p and mod q
 };
 
 NAMESPACE_END
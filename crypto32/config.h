@@ -37,6 +37,12 @@
 
 // #define LCRNG_ORIGINAL_NUMBERS
 
+// Define this to let some public key operations use more than one thread,
+// with Win32 threads on Windows and POSIX threads elsewhere. Programs
+// then have to be linked with a thread library, such as -lpthread.
+
+// #define THREADS_AVAILABLE
+
 // Define this if your compiler does not support namespaces
 
 // #define NO_NAMESPACE
@@ -62,7 +68,7 @@ typedef unsigned char byte;     // moved outside namespace for Borland C++Builde
 NAMESPACE_BEGIN(CryptoPP)
 
 typedef unsigned short word16;
-#if defined(__alpha) && !defined(_MSC_VER)
+#if (defined(__alpha) || defined(__LP64__)) && !defined(_MSC_VER)
 typedef unsigned int word32;
 #else
 typedef unsigned long word32;
@@ -78,14 +84,19 @@ typedef unsigned __int64 word64;
 #define W64LIT(x) x##ui64
 #endif
 
-#if defined(WORD64_AVAILABLE) && !defined(__alpha)
+#if defined(WORD64_AVAILABLE) && !defined(__alpha) && !defined(__LP64__)
 #define SLOW_WORD64
 #endif
 
 // word should have the same size as your CPU registers
 // dword should be twice as big as word
 
-#if (defined(__GNUC__) && !defined(__alpha)) || defined(__MWERKS__)
+#if defined(__GNUC__) && defined(__LP64__) && defined(__SIZEOF_INT128__)
+// 64-bit CPU registers, use the compiler's 128-bit type for double-width products
+typedef unsigned long word;
+typedef unsigned __int128 dword;
+#define WORD128_AVAILABLE
+#elif (defined(__GNUC__) && !defined(__alpha)) || defined(__MWERKS__)
 typedef unsigned long word;
 typedef unsigned long long dword;
 #elif defined(_MSC_VER) || defined(__BCPLUSPLUS__)
@@ -108,7 +119,10 @@ union dword_union
 	word w[2];
 };
 
-#ifdef IS_LITTLE_ENDIAN
+#if defined(WORD128_AVAILABLE)
+// the shift keeps the 128-bit value in registers instead of going through memory
+#define HIGH_WORD(x) (word)((x)>>WORD_BITS)
+#elif defined(IS_LITTLE_ENDIAN)
 #define HIGH_WORD(x) (dword_union(x).w[1])
 #else
 #define HIGH_WORD(x) (dword_union(x).w[0])
@@ -124,6 +138,8 @@ union dword_union
 #elif defined(__MWERKS__) && TARGET_CPU_PPC
 #define PPC_INTRINSICS
 #define FAST_ROTATE
+#elif defined(__GNUC__) && defined(__x86_64__) && defined(WORD128_AVAILABLE)
+#define X86_64_ASSEMBLY
 #endif
 
 #ifdef _MSC_VER
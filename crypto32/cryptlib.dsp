@@ -319,6 +319,10 @@ SOURCE=.\polynomi.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\pool.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\pubkey.cpp
 # End Source File
 # Begin Source File
@@ -423,6 +427,10 @@ SOURCE=.\tftables.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\thread.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\tiger.cpp
 # End Source File
 # Begin Source File
@@ -691,6 +699,10 @@ SOURCE=.\polynomi.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\pool.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\pssr.h
 # End Source File
 # Begin Source File
@@ -787,6 +799,10 @@ SOURCE=.\tea.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\thread.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\tiger.h
 # End Source File
 # Begin Source File
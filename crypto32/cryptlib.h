@@ -92,6 +92,8 @@ public:
 
 /// abstract base class for random number generators
 /** All return values are uniformly distributed over the range specified.
+	Every call changes the generator's state, so threads must not share
+	one without a lock.
 */
 class RandomNumberGenerator
 {
@@ -616,6 +618,14 @@ public:
 
 /** The class defines a common interface for doing precomputation,
 	and loading and saving precomputation.
+
+	Once its precomputation is done, the const functions of a public-key
+	object (encrypting, decrypting, signing, verifying, key agreement and
+	saving the precomputation) may be called from several threads at once,
+	each passing its own RandomNumberGenerator, since they do their
+	arithmetic in copies of the object's rings (see ModularArithmetic).  Precompute(),
+	LoadPrecomputation() and the other non-const functions must not run
+	at the same time as any other call on the object.
 */
 class PK_Precomputation
 {
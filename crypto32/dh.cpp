@@ -53,6 +53,16 @@ void DH::SavePrecomputation(BufferedTransformation &bt) const
 	gpc.Save(bt);
 }
 
+void DH::SavePrecomputationImage(BufferedTransformation &bt) const
+{
+	gpc.SaveImage(bt);
+}
+
+unsigned int DH::LoadPrecomputationImage(const byte *image, unsigned int length)
+{
+	return gpc.LoadImage(p, image, length);
+}
+
 bool DH::ValidateDomainParameters(RandomNumberGenerator &rng) const
 {
 	return VerifyPrime(rng, p) && VerifyPrime(rng, (p-1)/2) && g > 1 && g < p && Jacobi(g, p) == 1;
@@ -73,7 +83,8 @@ bool DH::Agree(byte *agreedValue, const byte *privateKey, const byte *otherPubli
 		return false;
 
 	Integer s(privateKey, PrivateKeyLength());
-	Integer z = a_exp_b_mod_c(w, s, p);
+	MontgomeryRepresentation mr(gpc.GetMontgomeryRepresentation());
+	Integer z = mr.ConvertOut(mr.FixedWindowExponentiate(mr.ConvertIn(w), s, ExponentBitLength()));
 	z.Encode(agreedValue, AgreedValueLength());
 	return true;
 }
@@ -19,6 +19,10 @@ public:
 	void Precompute(unsigned int precomputationStorage=16);
 	void LoadPrecomputation(BufferedTransformation &storedPrecomputation);
 	void SavePrecomputation(BufferedTransformation &storedPrecomputation) const;
+	// the precomputation as fixed-layout images, for sharing it between processes through a file
+	// they map read-only, see ModExpPrecomputation::SaveImage(), returns the number of bytes read
+	void SavePrecomputationImage(BufferedTransformation &storedPrecomputation) const;
+	unsigned int LoadPrecomputationImage(const byte *image, unsigned int length);
 
 	bool ValidateDomainParameters(RandomNumberGenerator &rng) const;
 	unsigned int AgreedValueLength() const {return p.ByteCount();}
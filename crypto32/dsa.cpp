@@ -33,6 +33,18 @@ void GDSADigestVerifier::SavePrecomputation(BufferedTransformation &bt) const
 	m_ypc.Save(bt);
 }
 
+void GDSADigestVerifier::SavePrecomputationImage(BufferedTransformation &bt) const
+{
+	m_gpc.SaveImage(bt);
+	m_ypc.SaveImage(bt);
+}
+
+unsigned int GDSADigestVerifier::LoadPrecomputationImage(const byte *image, unsigned int length)
+{
+	unsigned int read = m_gpc.LoadImage(m_p, image, length);
+	return read + m_ypc.LoadImage(m_p, image+read, length-read);
+}
+
 Integer GDSADigestVerifier::EncodeDigest(const byte *digest, unsigned int digestLen) const
 {
 	Integer h;
@@ -97,6 +109,50 @@ bool GDSADigestVerifier::RawVerify(const Integer &h, const Integer &r, const Int
 	return r == m_gpc.CascadeExponentiate(u1, m_ypc, u2) % m_q;
 }
 
+bool GDSADigestVerifier::VerifyDigests(unsigned int count, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid) const
+{
+	const ModExpPrecomputation *gpc = &m_gpc, *ypc = &m_ypc;
+	ModExpPrecomputation gpcBatch, ypcBatch;
+	if (BatchPrecomputationPays(count, STDMIN(m_gpc.Storage(), m_ypc.Storage())))
+	{
+		gpcBatch = m_gpc;
+		ypcBatch = m_ypc;
+		gpcBatch.Precompute(m_p, m_g, ExponentBitLength(), BATCH_PRECOMPUTATION_STORAGE);
+		ypcBatch.Precompute(m_p, m_y, ExponentBitLength(), BATCH_PRECOMPUTATION_STORAGE);
+		gpc = &gpcBatch;
+		ypc = &ypcBatch;
+	}
+
+	unsigned int qLen = m_q.ByteCount();
+	std::vector<Integer> r(count), w(count);
+	unsigned int i;
+
+	for (i=0; i<count; i++)
+	{
+		r[i].Decode(signatures[i], qLen);
+		w[i].Decode(signatures[i]+qLen, qLen);
+		valid[i] = r[i]<m_q && r[i]>=1 && w[i]<m_q && w[i]>=1;
+		if (!valid[i])
+			w[i] = Integer::Zero();
+	}
+
+	// one batch doesn't pay for setting up a faster reduction
+	ModularArithmetic(m_q, ModularArithmetic::DIVISION).BatchInverse(&w[0], count);
+
+	bool pass = true;
+	for (i=0; i<count; i++)
+	{
+		if (valid[i])
+		{
+			Integer u1 = (EncodeDigest(digests[i], digestLens[i]) * w[i]) % m_q;
+			Integer u2 = (r[i] * w[i]) % m_q;
+			valid[i] = r[i] == gpc->CascadeExponentiate(u1, *ypc, u2) % m_q;
+		}
+		pass = pass && valid[i];
+	}
+	return pass;
+}
+
 // ******************************************************************
 
 GDSADigestSigner::GDSADigestSigner(const Integer &p, const Integer &q, const Integer &g, const Integer &y, const Integer &x)
@@ -157,10 +213,14 @@ void GDSADigestSigner::SignDigest(RandomNumberGenerator &rng, const byte *digest
 	assert(digestLen <= MaxDigestLength());
 
 	Integer h = EncodeDigest(digest, digestLen);
-	Integer k(rng, 2, m_q-2);
 	Integer r, s;
 
-	RawSign(k, h, r, s);
+	if (!m_noncePool.Sign(m_x, h, r, s))	// the pool was empty, or another k is needed
+	{
+		Integer k(rng, 2, m_q-2);
+		RawSign(k, h, r, s);
+	}
+
 	r.Encode(signature, m_q.ByteCount());
 	s.Encode(signature+m_q.ByteCount(), m_q.ByteCount());
 }
@@ -3,6 +3,7 @@
 
 #include "pubkey.h"
 #include "modexppc.h"
+#include "pool.h"
 #include "sha.h"
 
 #include <limits.h>
@@ -22,9 +23,16 @@ public:
 	void Precompute(unsigned int precomputationStorage=16);
 	void LoadPrecomputation(BufferedTransformation &storedPrecomputation);
 	void SavePrecomputation(BufferedTransformation &storedPrecomputation) const;
+	// the precomputation as fixed-layout images, for sharing it between processes through a file
+	// they map read-only, see ModExpPrecomputation::SaveImage(), returns the number of bytes read
+	void SavePrecomputationImage(BufferedTransformation &storedPrecomputation) const;
+	unsigned int LoadPrecomputationImage(const byte *image, unsigned int length);
 
 	void DEREncode(BufferedTransformation &bt) const;
 	bool VerifyDigest(const byte *digest, unsigned int digestLen, const byte *signature) const;
+	// verifies count signatures under this key, sharing one modular inversion and, when enough
+	// signatures pay for them, larger precomputation tables, see BatchPrecomputationPays()
+	bool VerifyDigests(unsigned int count, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid) const;
 
 	unsigned int MaxDigestLength() const {return UINT_MAX;}
 	unsigned int DigestSignatureLength() const {return 2*m_q.ByteCount();}
@@ -57,6 +65,16 @@ public:
 	void DEREncode(BufferedTransformation &bt) const;
 	void SignDigest(RandomNumberGenerator &rng, const byte *digest, unsigned int digestLen, byte *signature) const;
 
+	// offline/online signing: keeps up to capacity nonces k with their r = g^k mod p mod q,
+	// generated by a background thread using rng, which this object takes ownership of, so
+	// that SignDigest() has only a few multiplications mod q to do while the pool lasts,
+	// call it after Precompute(), copies of this object share the pool
+	void StartNoncePool(RandomNumberGenerator *rng, unsigned int capacity=64)
+		{m_noncePool.Start(rng, m_gpc, m_q, true, capacity);}
+	void StopNoncePool() {m_noncePool.Stop();}
+	// all zero if there is no pool
+	PrecomputedPoolStatistics GetNoncePoolStatistics() const {return m_noncePool.GetStatistics();}
+
 	const Integer & GetPrivateExponent() const {return m_x;}
 
 	// exposed for validation testing
@@ -66,6 +84,7 @@ protected:
 	GDSADigestSigner() {}
 
 	Integer m_x;
+	SigningNoncePool<ModExpPrecomputation> m_noncePool;
 };
 
 template <class H>
@@ -10,6 +10,39 @@
 
 NAMESPACE_BEGIN(CryptoPP)
 
+ANONYMOUS_NAMESPACE_BEGIN
+// the elements are Lopez-Dahab points
+class EC2NImageCodec
+{
+public:
+	EC2NImageCodec(const GF2N &field) : field(field), size(field.GetModulus().ByteCount()) {}
+
+	word32 Tag() const {return 4;}
+	unsigned int Coordinates() const {return 3;}
+	unsigned int CoordinateSize() const {return size;}
+	void EncodeModulus(byte *output) const {field.GetModulus().Encode(output, size);}
+	void Encode(byte *output, const EC2NProjectivePoint &P) const
+	{
+		P.x.Encode(output, size);
+		P.y.Encode(output+size, size);
+		P.z.Encode(output+2*size, size);
+	}
+	void Decode(EC2NProjectivePoint &P, const byte *input) const
+	{
+		P.x.Decode(input, size);
+		P.y.Decode(input+size, size);
+		P.z.Decode(input+2*size, size);
+		const int degree = field.GetModulus().Degree();
+		if (P.x.Degree() >= degree || P.y.Degree() >= degree || P.z.Degree() >= degree)
+			throw InvalidPrecomputationImage();
+	}
+
+private:
+	const GF2N &field;
+	unsigned int size;
+};
+NAMESPACE_END
+
 EC2N::Point EC2N::DecodePoint(const byte *encodedPoint) const
 {
 	if (encodedPoint[0] != 4)	// TODO: handle compressed points
@@ -117,20 +150,229 @@ const EC2N::Point& EC2N::Double(const Point &P) const
 	return R;
 }
 
+ProjectiveEC2N::Point ProjectiveEC2N::FromAffine(const EC2NPoint &P) const
+{
+	return P.identity ? Zero() : Point(P.x, P.y, PolynomialMod2::One());
+}
+
+EC2NPoint ProjectiveEC2N::ToAffine(const Point &P) const
+{
+	if (!P.z)
+		return EC2NPoint();
+	if (P.z.IsUnit())
+		return EC2NPoint(P.x, P.y);
+
+	FieldElement zInv = field.MultiplicativeInverse(P.z);
+	FieldElement x = field.Multiply(P.x, zInv);
+	return EC2NPoint(x, field.Multiply(P.y, field.Square(zInv)));
+}
+
+void ProjectiveEC2N::Normalize(Point *points, unsigned int count) const
+{
+	std::vector<FieldElement> zInv(count);
+	unsigned int i;
+	for (i=0; i<count; i++)
+		zInv[i] = points[i].z;
+
+	BatchInversion(field, zInv.begin(), zInv.end());
+
+	for (i=0; i<count; i++)
+	{
+		if (!zInv[i])
+			continue;
+		points[i].x = field.Multiply(points[i].x, zInv[i]);
+		points[i].y = field.Multiply(points[i].y, field.Square(zInv[i]));
+		points[i].z = PolynomialMod2::One();
+	}
+}
+
+bool ProjectiveEC2N::Equal(const Point &P, const Point &Q) const
+{
+	if (!P.z || !Q.z)
+		return !P.z && !Q.z;
+
+	// compare x1*z2 with x2*z1 and y1*z2^2 with y2*z1^2
+	FieldElement t1 = field.Multiply(P.x, Q.z), t2 = field.Multiply(Q.x, P.z);
+	if (!field.Equal(t1, t2))
+		return false;
+	t1 = field.Multiply(P.y, field.Square(Q.z));
+	t2 = field.Multiply(Q.y, field.Square(P.z));
+	return field.Equal(t1, t2);
+}
+
+const ProjectiveEC2N::Point& ProjectiveEC2N::Zero() const
+{
+	static const Point zero(PolynomialMod2::One(), PolynomialMod2::Zero(), PolynomialMod2::Zero());
+	return zero;
+}
+
+const ProjectiveEC2N::Point& ProjectiveEC2N::Inverse(const Point &P) const
+{
+	// -(x, y) = (x, x+y)
+	FieldElement y = field.Multiply(P.x, P.z);
+	field.Accumulate(y, P.y);
+	R.x = P.x;
+	R.z = P.z;
+	R.y.swap(y);
+	return R;
+}
+
+void ProjectiveEC2N::AccumulateA(FieldElement &s, const FieldElement &t) const
+{
+	if (a.IsUnit())
+		field.Accumulate(s, t);
+	else if (!!a)
+		field.Accumulate(s, field.Multiply(a, t));
+}
+
+const ProjectiveEC2N::Point& ProjectiveEC2N::Add(const Point &P, const Point &Q) const
+{
+	if (!P.z) return Q;
+	if (!Q.z) return P;
+	if (P.z.IsUnit() && !Q.z.IsUnit())
+		return Add(Q, P);
+
+	FieldElement x, y, z;
+	FieldElement pz2 = field.Square(P.z);
+
+	if (Q.z.IsUnit())
+	{
+		// mixed addition, 8 multiplications and 5 squarings
+		FieldElement s = field.Multiply(Q.y, pz2);
+		field.Accumulate(s, P.y);
+		FieldElement t = field.Multiply(Q.x, P.z);
+		field.Accumulate(t, P.x);
+		if (!t)
+			return !s ? Double(P) : Zero();
+
+		FieldElement c = field.Multiply(P.z, t);
+		FieldElement d = c;
+		AccumulateA(d, pz2);
+		d = field.Multiply(field.Square(t), d);
+		z = field.Square(c);
+		FieldElement e = field.Multiply(s, c);
+
+		x = field.Square(s);
+		field.Accumulate(x, d);
+		field.Accumulate(x, e);
+		FieldElement f = field.Multiply(Q.x, z);
+		field.Accumulate(f, x);
+		field.Accumulate(e, z);
+		y = field.Multiply(e, f);
+		FieldElement g = field.Add(Q.x, Q.y);
+		field.Accumulate(y, field.Multiply(g, field.Square(z)));
+	}
+	else
+	{
+		// with u1 = x1*z2, u2 = x2*z1, s1 = y1*z2^2, s2 = y2*z1^2, e = z1*z2, the sum is
+		// z3 = (d*e)^2, x3 = c^2 + c*d*e + d^2*(d*e + a*e^2), y3 = z3*d*(c*u1 + d*s1) + x3*(c*d*e + z3),
+		// where c = s1+s2 and d = u1+u2
+		FieldElement qz2 = field.Square(Q.z);
+		FieldElement u1 = field.Multiply(P.x, Q.z);
+		FieldElement s1 = field.Multiply(P.y, qz2);
+		FieldElement d = field.Multiply(Q.x, P.z);
+		field.Accumulate(d, u1);
+		FieldElement c = field.Multiply(Q.y, pz2);
+		field.Accumulate(c, s1);
+		if (!d)
+			return !c ? Double(P) : Zero();
+
+		FieldElement e = field.Multiply(P.z, Q.z);
+		FieldElement f = field.Multiply(d, e);
+		FieldElement g = f;
+		AccumulateA(g, field.Square(e));
+		g = field.Multiply(field.Square(d), g);
+		z = field.Square(f);
+		FieldElement cf = field.Multiply(c, f);
+
+		x = field.Square(c);
+		field.Accumulate(x, cf);
+		field.Accumulate(x, g);
+		FieldElement t = field.Multiply(c, u1);
+		field.Accumulate(t, field.Multiply(d, s1));
+		t = field.Multiply(d, t);
+		t = field.Multiply(z, t);
+		field.Accumulate(cf, z);
+		y = field.Multiply(x, cf);
+		field.Accumulate(y, t);
+	}
+
+	R.x.swap(x);
+	R.y.swap(y);
+	R.z.swap(z);
+	return R;
+}
+
+const ProjectiveEC2N::Point& ProjectiveEC2N::Double(const Point &P) const
+{
+	if (!P.z || !P.x)
+		return Zero();
+
+	// z3 = x^2*z^2, x3 = x^4 + b*z^4, y3 = b*z^4*z3 + x3*(a*z3 + y^2 + b*z^4)
+	FieldElement x2 = field.Square(P.x);
+	FieldElement z2 = field.Square(P.z);
+	FieldElement t = field.Square(P.y);
+	FieldElement bz4 = field.Multiply(b, field.Square(z2));
+	FieldElement z = field.Multiply(x2, z2);
+	FieldElement x = field.Square(x2);
+	field.Accumulate(x, bz4);
+	field.Accumulate(t, bz4);
+	AccumulateA(t, z);
+	FieldElement y = field.Multiply(x, t);
+	field.Accumulate(y, field.Multiply(bz4, z));
+
+	R.x.swap(x);
+	R.y.swap(y);
+	R.z.swap(z);
+	return R;
+}
+
+ProjectiveEC2N::Point ProjectiveEC2N::ScalarMultiply(const Point &P, const Integer &k) const
+{
+	std::pair<Integer, Point> pair(k, P);
+	return InterleavedWindowMultiplication(*this, &pair, &pair+1);
+}
+
+ProjectiveEC2N::Point ProjectiveEC2N::CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const
+{
+	std::pair<Integer, Point> pairs[2] = {std::make_pair(k1, P), std::make_pair(k2, Q)};
+	return InterleavedWindowMultiplication(*this, pairs, pairs+2);
+}
+
+EC2N::Point EC2N::ScalarMultiply(const Point &P, const Integer &k) const
+{
+	Field f(field);
+	ProjectiveEC2N pec(f, a, b);
+	return pec.ToAffine(pec.ScalarMultiply(pec.FromAffine(P), k));
+}
+
+EC2N::Point EC2N::CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const
+{
+	Field f(field);
+	ProjectiveEC2N pec(f, a, b);
+	return pec.ToAffine(pec.CascadeScalarMultiply(pec.FromAffine(P), k1, pec.FromAffine(Q), k2));
+}
+
 // ********************************************************
 
 EcPrecomputation<EC2N>::EcPrecomputation()
+	: combTeeth(DEFAULT_COMB_TEETH)
 {
 }
 
 EcPrecomputation<EC2N>::EcPrecomputation(const EcPrecomputation<EC2N> &ecp)
 	: ec(new EC2N(*ecp.ec))
-	, ep(new ExponentiationPrecomputation<EC2N::Point>(*ec, *ecp.ep))
+	, pec(new ProjectiveEC2N(ec->GetField(), ec->GetA(), ec->GetB()))
+	, ep(new ExponentiationPrecomputation<EC2NProjectivePoint>(*pec, *ecp.ep))
+	, combTeeth(ecp.combTeeth)
 {
 }
 
-EcPrecomputation<EC2N>::EcPrecomputation(const EC2N &ecIn, const EC2N::Point &base, unsigned int maxExpBits, unsigned int storage)
-	: ec(new EC2N(ecIn)), ep(NULL)
+EcPrecomputation<EC2N>::EcPrecomputation(const EC2N &ecIn, const EC2N::Point &base, unsigned int maxExpBits, unsigned int storage, unsigned int teeth)
+	: ec(new EC2N(ecIn))
+	, pec(new ProjectiveEC2N(ec->GetField(), ec->GetA(), ec->GetB()))
+	, ep(NULL)
+	, combTeeth(teeth)
 {
 	Precompute(base, maxExpBits, storage);
 }
@@ -142,28 +384,60 @@ EcPrecomputation<EC2N>::~EcPrecomputation()
 void EcPrecomputation<EC2N>::Precompute(const EC2N::Point &base, unsigned int maxExpBits, unsigned int storage)
 {
 	if (!ep.get() || ep->storage < storage)
-		ep.reset(new ExponentiationPrecomputation<EC2NPoint>(*ec, base, maxExpBits, storage));
+	{
+		ep.reset(new ExponentiationPrecomputation<EC2NProjectivePoint>(*pec, pec->FromAffine(base), maxExpBits, storage));
+		pec->Normalize(&ep->g[0], ep->g.size());
+		PrecomputeComb();
+	}
 }
 
 void EcPrecomputation<EC2N>::Load(BufferedTransformation &bt)
 {
-	ep.reset(new ExponentiationPrecomputation<EC2NPoint>(*ec));
+	ep.reset(new ExponentiationPrecomputation<EC2NProjectivePoint>(*pec));
 	BERSequenceDecoder seq(bt);
 	ep->storage = (unsigned int)(Integer(seq).ConvertToLong());
 	ep->exponentBase.BERDecode(seq);
 	ep->g.resize(ep->storage);
 
 	unsigned int size = ec->GetField().MaxElementByteLength();
+	const int degree = ec->GetField().GetModulus().Degree();
 	SecByteBlock buffer(size);
 	for (unsigned i=0; i<ep->storage; i++)
 	{
-		ep->g[i].identity = false;
 		seq.Get(buffer, size);
 		ep->g[i].x.Decode(buffer, size);
 		seq.Get(buffer, size);
 		ep->g[i].y.Decode(buffer, size);
+		if (ep->g[i].x.Degree() >= degree || ep->g[i].y.Degree() >= degree)
+			BERDecodeError();
+		ep->g[i].z = PolynomialMod2::One();
 	}
 	seq.OutputFinished();
+	PrecomputeComb();
+}
+
+void EcPrecomputation<EC2N>::SetCombTeeth(unsigned int teeth)
+{
+	combTeeth = teeth;
+	if (ep.get())
+		PrecomputeComb();
+}
+
+unsigned int EcPrecomputation<EC2N>::Storage() const
+{
+	return ep.get() ? ep->storage : 0;
+}
+
+bool EcPrecomputation<EC2N>::HasCombTables() const
+{
+	return ep.get() && !ep->comb.empty();
+}
+
+void EcPrecomputation<EC2N>::PrecomputeComb()
+{
+	ep->PrecomputeComb(combTeeth);
+	if (!ep->comb.empty())
+		pec->Normalize(&ep->comb[0], ep->comb.size());
 }
 
 void EcPrecomputation<EC2N>::Save(BufferedTransformation &bt) const
@@ -185,16 +459,32 @@ void EcPrecomputation<EC2N>::Save(BufferedTransformation &bt) const
 	seq.InputFinished();
 }
 
+void EcPrecomputation<EC2N>::SaveImage(BufferedTransformation &bt) const
+{
+	assert(ep.get());
+	SavePrecomputationImage(bt, *ep, EC2NImageCodec(ec->GetField()));
+}
+
+unsigned int EcPrecomputation<EC2N>::LoadImage(const byte *image, unsigned int length)
+{
+	ep.reset(new ExponentiationPrecomputation<EC2NProjectivePoint>(*pec));
+	return LoadPrecomputationImage(*ep, image, length, EC2NImageCodec(ec->GetField()));
+}
+
 EC2N::Point EcPrecomputation<EC2N>::Multiply(const Integer &exponent) const
 {
 	assert(ep.get());
-	return ep->Exponentiate(exponent);
+	EC2N::Field f(ec->GetField());
+	ProjectiveEC2N pec(f, ec->GetA(), ec->GetB());
+	return pec.ToAffine(ep->Exponentiate(pec, exponent));
 }
 
 EC2N::Point EcPrecomputation<EC2N>::CascadeMultiply(const Integer &exponent, const EcPrecomputation<EC2N> &pc2, const Integer &exponent2) const
 {
 	assert(ep.get());
-	return ep->CascadeExponentiate(exponent, *pc2.ep, exponent2);
+	EC2N::Field f(ec->GetField());
+	ProjectiveEC2N pec(f, ec->GetA(), ec->GetB());
+	return pec.ToAffine(ep->CascadeExponentiate(pec, exponent, *pc2.ep, exponent2));
 }
 
 NAMESPACE_END
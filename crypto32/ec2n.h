@@ -33,12 +33,19 @@ public:
 	EC2N(const Field &field, const Field::Element &a, const Field::Element &b)
 		: field(field), a(a), b(b) {}
 
+	// as with ECP, only one thread at a time may call Add(), Double() and Inverse(), whose
+	// results are kept in this object, the other functions may be called from several at once
 	bool Equal(const Point &P, const Point &Q) const;
 	const Point& Zero() const {static const Point zero; return zero;}
 	const Point& Inverse(const Point &P) const;
+	bool InversionIsFast() const {return true;}
 	const Point& Add(const Point &P, const Point &Q) const;
 	const Point& Double(const Point &P) const;
 
+	// these two work in Lopez-Dahab coordinates internally, see ProjectiveEC2N
+	Point ScalarMultiply(const Point &P, const Integer &k) const;
+	Point CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const;
+
 	Point Multiply(const Integer &k, const Point &P) const
 		{return ScalarMultiply(P, k);}
 	Point CascadeMultiply(const Integer &k1, const Point &P, const Integer &k2, const Point &Q) const
@@ -63,6 +70,52 @@ private:
 	mutable Point R;
 };
 
+// the point (x/z, y/z^2) in Lopez-Dahab coordinates, z is 0 for the point at infinity
+struct EC2NProjectivePoint
+{
+	EC2NProjectivePoint() {}
+	EC2NProjectivePoint(const PolynomialMod2 &x, const PolynomialMod2 &y, const PolynomialMod2 &z)
+		: x(x), y(y), z(z) {}
+
+	PolynomialMod2 x, y, z;
+};
+
+// the points of an EC2N in Lopez-Dahab coordinates, where Add() and Double() don't need a
+// field inversion, Add() is cheapest if its second argument has z == 1 (mixed addition)
+class ProjectiveEC2N : public AbstractGroup<EC2NProjectivePoint>
+{
+public:
+	typedef GF2N Field;
+	typedef Field::Element FieldElement;
+
+	typedef EC2NProjectivePoint Point;
+
+	ProjectiveEC2N(const Field &field, const FieldElement &a, const FieldElement &b)
+		: field(field), a(a), b(b) {}
+
+	Point FromAffine(const EC2NPoint &P) const;
+	EC2NPoint ToAffine(const Point &P) const;
+	// sets z = 1 in each of points[0..count), using one field inversion in all
+	void Normalize(Point *points, unsigned int count) const;
+
+	bool Equal(const Point &P, const Point &Q) const;
+	const Point& Zero() const;
+	const Point& Inverse(const Point &P) const;
+	bool InversionIsFast() const {return true;}
+	const Point& Add(const Point &P, const Point &Q) const;
+	const Point& Double(const Point &P) const;
+	Point ScalarMultiply(const Point &P, const Integer &k) const;
+	Point CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const;
+
+private:
+	// a*t, skipping the multiplication for the common curves with a == 0 or a == 1
+	void AccumulateA(FieldElement &s, const FieldElement &t) const;
+
+	const Field &field;
+	FieldElement a, b;
+	mutable Point R;
+};
+
 template <class T> class EcPrecomputation;
 
 template<> class EcPrecomputation<EC2N>
@@ -70,19 +123,36 @@ template<> class EcPrecomputation<EC2N>
 public:
 	EcPrecomputation();
 	EcPrecomputation(const EcPrecomputation<EC2N> &ecp);
-	EcPrecomputation(const EC2N &ecIn, const EC2N::Point &base, unsigned int maxExpBits, unsigned int storage);
+	EcPrecomputation(const EC2N &ecIn, const EC2N::Point &base, unsigned int maxExpBits, unsigned int storage, unsigned int combTeeth=DEFAULT_COMB_TEETH);
 	~EcPrecomputation();
 
 	void Precompute(const EC2N::Point &base, unsigned int maxExpBits, unsigned int storage);
 	void Load(BufferedTransformation &storedPrecomputation);
 	void Save(BufferedTransformation &storedPrecomputation) const;
+	// a fixed-layout image of the points including the comb tables, which LoadImage() reads without
+	// parsing, for sharing a precomputation between processes through a file they map read-only
+	void SaveImage(BufferedTransformation &storedPrecomputation) const;
+	// returns the number of bytes of image read, throws InvalidPrecomputationImage if it doesn't fit the curve,
+	// and uses the comb tables in the image, SetCombTeeth() only applies to tables built here
+	unsigned int LoadImage(const byte *image, unsigned int length);
+
+	// Multiply() and CascadeMultiply() use fixed-base comb tables of about (storage/teeth)*2^teeth
+	// points built from the stored ones, more teeth trade memory for speed, 0 turns the tables off
+	void SetCombTeeth(unsigned int teeth);
+	// the number of precomputed multiples of the base, 0 if there are none yet
+	unsigned int Storage() const;
+	bool HasCombTables() const;
 
 	EC2N::Point Multiply(const Integer &exponent) const;
 	EC2N::Point CascadeMultiply(const Integer &exponent, const EcPrecomputation<EC2N> &pc2, const Integer &exponent2) const;
 
 private:
+	void PrecomputeComb();
+
 	member_ptr<EC2N> ec;
-	member_ptr< ExponentiationPrecomputation<EC2N::Point> > ep;
+	member_ptr<ProjectiveEC2N> pec;
+	member_ptr< ExponentiationPrecomputation<EC2NProjectivePoint> > ep;	// the bases and comb tables have z == 1
+	unsigned int combTeeth;
 };
 
 NAMESPACE_END
@@ -20,6 +20,12 @@ static inline Integer ConvertToInteger(const Integer &x)
 	return x;
 }
 
+// for SigningNoncePool
+template <class EC> Integer NonceCommitment(const EcPrecomputation<EC> &Ppc, const Integer &k)
+{
+	return ConvertToInteger(Ppc.Multiply(k).x);
+}
+
 static bool CheckMOVCondition(const Integer &q, const Integer &r)
 {
 	Integer t=1;
@@ -54,6 +60,12 @@ template <class EC, ECSignatureScheme SS> void ECPublicKey<EC, SS>::Precompute(u
 	Qpc.Precompute(Q, ExponentBitLength(), precomputationStorage);
 }
 
+template <class EC, ECSignatureScheme SS> void ECPublicKey<EC, SS>::SetCombTeeth(unsigned int teeth)
+{
+	Ppc.SetCombTeeth(teeth);
+	Qpc.SetCombTeeth(teeth);
+}
+
 template <class EC, ECSignatureScheme SS> void ECPublicKey<EC, SS>::LoadPrecomputation(BufferedTransformation &bt)
 {
 	Ppc.Load(bt);
@@ -66,6 +78,18 @@ template <class EC, ECSignatureScheme SS> void ECPublicKey<EC, SS>::SavePrecompu
 	Qpc.Save(bt);
 }
 
+template <class EC, ECSignatureScheme SS> void ECPublicKey<EC, SS>::SavePrecomputationImage(BufferedTransformation &bt) const
+{
+	Ppc.SaveImage(bt);
+	Qpc.SaveImage(bt);
+}
+
+template <class EC, ECSignatureScheme SS> unsigned int ECPublicKey<EC, SS>::LoadPrecomputationImage(const byte *image, unsigned int length)
+{
+	unsigned int read = Ppc.LoadImage(image, length);
+	return read + Qpc.LoadImage(image+read, length-read);
+}
+
 template <class EC, ECSignatureScheme SS>
 Integer ECPublicKey<EC, SS>::EncodeDigest(const byte *digest, unsigned int digestLen) const
 {
@@ -152,6 +176,55 @@ template <class EC, ECSignatureScheme SS> bool ECPublicKey<EC, SS>::VerifyDigest
 	return RawVerify(e, r, s);
 }
 
+template <class EC, ECSignatureScheme SS> bool ECPublicKey<EC, SS>::VerifyDigests(unsigned int count, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid) const
+{
+	const EcPrecomputation<EC> *pPpc = &Ppc, *pQpc = &Qpc;
+	member_ptr<EcPrecomputation<EC> > PpcBatch, QpcBatch;
+	// comb tables are the caller's choice of speed, and faster than those built here
+	if (!Ppc.HasCombTables() && BatchPrecomputationPays(count, STDMIN(Ppc.Storage(), Qpc.Storage())))
+	{
+		PpcBatch.reset(new EcPrecomputation<EC>(ec, P, ExponentBitLength(), BATCH_PRECOMPUTATION_STORAGE, 0));
+		QpcBatch.reset(new EcPrecomputation<EC>(ec, Q, ExponentBitLength(), BATCH_PRECOMPUTATION_STORAGE, 0));
+		pPpc = PpcBatch.get();
+		pQpc = QpcBatch.get();
+	}
+
+	std::vector<Integer> r(count), s(count);
+	unsigned int i;
+
+	for (i=0; i<count; i++)
+	{
+		r[i].Decode(signatures[i], f);
+		s[i].Decode(signatures[i]+f, f);
+		valid[i] = r[i]<n && r[i]>=1 && s[i]<n && (SS == ECNR || s[i]>=1);
+		if (!valid[i])
+			s[i] = Integer::Zero();
+	}
+
+	// s is replaced by w = s^-1 mod n for ECDSA
+	if (SS == ECDSA)
+		ModularArithmetic(n, ModularArithmetic::DIVISION).BatchInverse(&s[0], count);
+
+	bool pass = true;
+	for (i=0; i<count; i++)
+	{
+		if (valid[i])
+		{
+			Integer e = EncodeDigest(digests[i], digestLens[i]);
+			if (SS == ECNR)
+				valid[i] = r[i] == (ConvertToInteger(pPpc->CascadeMultiply(s[i], *pQpc, r[i]).x) + e) % n;
+			else
+			{
+				Integer u1 = (e * s[i]) % n;
+				Integer u2 = (r[i] * s[i]) % n;
+				valid[i] = r[i] == ConvertToInteger(pPpc->CascadeMultiply(u1, *pQpc, u2).x) % n;
+			}
+		}
+		pass = pass && valid[i];
+	}
+	return pass;
+}
+
 // ******************************************************************
 
 template <class EC, ECSignatureScheme SS> ECPrivateKey<EC, SS>::~ECPrivateKey()
@@ -219,14 +292,22 @@ template <class EC, ECSignatureScheme SS> void ECPrivateKey<EC, SS>::SignDigest(
 {
 	Integer r, s;
 	Integer e = EncodeDigest(digest, digestLen);
-	Integer k(rng, 2, n-2, Integer::ANY);
 
-	RawSign(k, e, r, s);
+	if (!m_noncePool.Sign(d, e, r, s))	// the pool was empty, or another k is needed
+	{
+		Integer k(rng, 2, n-2, Integer::ANY);
+		RawSign(k, e, r, s);
+	}
 
 	r.Encode(signature, f);
 	s.Encode(signature+f, f);
 }
 
+template <class EC, ECSignatureScheme SS> void ECPrivateKey<EC, SS>::StartNoncePool(RandomNumberGenerator *rng, unsigned int capacity)
+{
+	m_noncePool.Start(rng, Ppc, n, SS == ECDSA, capacity);
+}
+
 // ******************************************************************
 
 template <class EC>
@@ -246,6 +327,12 @@ void ECDHC<EC>::Precompute(unsigned int precomputationStorage)
 	Gpc.Precompute(G, r.BitCount(), precomputationStorage);
 }
 
+template <class EC>
+void ECDHC<EC>::SetCombTeeth(unsigned int teeth)
+{
+	Gpc.SetCombTeeth(teeth);
+}
+
 template <class EC>
 void ECDHC<EC>::LoadPrecomputation(BufferedTransformation &bt)
 {
@@ -311,6 +398,12 @@ void ECMQVC<EC>::Precompute(unsigned int precomputationStorage)
 	Gpc.Precompute(G, r.BitCount(), precomputationStorage);
 }
 
+template <class EC>
+void ECMQVC<EC>::SetCombTeeth(unsigned int teeth)
+{
+	Gpc.SetCombTeeth(teeth);
+}
+
 template <class EC>
 void ECMQVC<EC>::LoadPrecomputation(BufferedTransformation &bt)
 {
@@ -3,6 +3,7 @@
 
 #include "pubkey.h"
 #include "integer.h"
+#include "pool.h"
 
 NAMESPACE_BEGIN(CryptoPP)
 
@@ -42,9 +43,19 @@ public:
 	void Precompute(unsigned int precomputationStorage=16);
 	void LoadPrecomputation(BufferedTransformation &storedPrecomputation);
 	void SavePrecomputation(BufferedTransformation &storedPrecomputation) const;
+	// the precomputation as fixed-layout images, for sharing it between processes through a file
+	// they map read-only, see EcPrecomputation<>::SaveImage(), returns the number of bytes read
+	void SavePrecomputationImage(BufferedTransformation &storedPrecomputation) const;
+	unsigned int LoadPrecomputationImage(const byte *image, unsigned int length);
+	// trades memory for speed in the precomputed multiplications, see EcPrecomputation<>::SetCombTeeth()
+	void SetCombTeeth(unsigned int teeth);
 
 	void Encrypt(RandomNumberGenerator &rng, const byte *plainText, unsigned int plainTextLength, byte *cipherText);
 	bool VerifyDigest(const byte *digest, unsigned int digestLen, const byte *signature) const;
+	// verifies count signatures under this key, sharing one modular inversion (ECDSA) and, when
+	// enough signatures pay for them and the key has no comb tables, larger precomputation
+	// tables, see BatchPrecomputationPays()
+	bool VerifyDigests(unsigned int count, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid) const;
 
 	unsigned int MaxPlainTextLength() const {return l-2;}
 	unsigned int CipherTextLength() const {return 3*l+1;}
@@ -91,6 +102,15 @@ public:
 	unsigned int Decrypt(const byte *cipherText, byte *plainText);
 	void SignDigest(RandomNumberGenerator &, const byte *digest, unsigned int digestLen, byte *signature) const;
 
+	// offline/online signing: keeps up to capacity nonces k with x(kP) mod n, generated by a
+	// background thread using rng, which this object takes ownership of, so that SignDigest()
+	// has only a few multiplications mod n to do while the pool lasts, call it after
+	// Precompute(), copies of this object share the pool
+	void StartNoncePool(RandomNumberGenerator *rng, unsigned int capacity=64);
+	void StopNoncePool() {m_noncePool.Stop();}
+	// all zero if there is no pool
+	PrecomputedPoolStatistics GetNoncePoolStatistics() const {return m_noncePool.GetStatistics();}
+
 	// exposed for validation testing
 	void RawSign(const Integer &k, const Integer &e, Integer &r, Integer &s) const;
 
@@ -98,6 +118,7 @@ protected:
 	typedef typename EC::FieldElement FieldElement;
 	void Randomize(RandomNumberGenerator &rng);
 	Integer d;
+	SigningNoncePool<EcPrecomputation<EC> > m_noncePool;
 };
 
 template <class EC, class H, ECSignatureScheme SS = ECNR>
@@ -141,6 +162,8 @@ public:
 	void Precompute(unsigned int precomputationStorage=16);
 	void LoadPrecomputation(BufferedTransformation &storedPrecomputation);
 	void SavePrecomputation(BufferedTransformation &storedPrecomputation) const;
+	// trades memory for speed in the precomputed multiplications, see EcPrecomputation<>::SetCombTeeth()
+	void SetCombTeeth(unsigned int teeth);
 
 	bool ValidateDomainParameters(RandomNumberGenerator &rng) const;
 	unsigned int AgreedValueLength() const {return ec.GetField().MaxElementByteLength();}
@@ -171,6 +194,8 @@ public:
 	void Precompute(unsigned int precomputationStorage=16);
 	void LoadPrecomputation(BufferedTransformation &storedPrecomputation);
 	void SavePrecomputation(BufferedTransformation &storedPrecomputation) const;
+	// trades memory for speed in the precomputed multiplications, see EcPrecomputation<>::SetCombTeeth()
+	void SetCombTeeth(unsigned int teeth);
 
 	bool ValidateDomainParameters(RandomNumberGenerator &rng) const;
 	unsigned int AgreedValueLength() const {return ec.GetField().MaxElementByteLength();}
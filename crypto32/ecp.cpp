@@ -11,15 +11,54 @@
 NAMESPACE_BEGIN(CryptoPP)
 
 ANONYMOUS_NAMESPACE_BEGIN
-static inline ECP::Point ToMontgomery(const MontgomeryRepresentation &mr, const ECP::Point &P)
+static inline ECP::Point ToField(const ModularArithmetic &field, const ECP::Point &P)
 {
-	return P.identity ? P : ECP::Point(mr.ConvertIn(P.x), mr.ConvertIn(P.y));
+	return P.identity ? P : ECP::Point(field.ConvertIn(P.x), field.ConvertIn(P.y));
 }
 
-static inline ECP::Point FromMontgomery(const MontgomeryRepresentation &mr, const ECP::Point &P)
+static inline ECP::Point FromField(const ModularArithmetic &field, const ECP::Point &P)
 {
-	return P.identity ? P : ECP::Point(mr.ConvertOut(P.x), mr.ConvertOut(P.y));
+	return P.identity ? P : ECP::Point(field.ConvertOut(P.x), field.ConvertOut(P.y));
 }
+
+// a special form modulus reduces faster than Montgomery representation
+static ModularArithmetic * NewFastestField(const Integer &modulus)
+{
+	if (ModularArithmetic::HasSpecialForm(modulus))
+		return new ModularArithmetic(modulus, ModularArithmetic::SPECIAL_FORM);
+	else
+		return new MontgomeryRepresentation(modulus);
+}
+
+// the elements are Jacobian points, in Montgomery representation unless the field has a special form
+class ECPImageCodec
+{
+public:
+	ECPImageCodec(const ModularArithmetic &field) : field(field), size(field.GetModulus().ByteCount()) {}
+
+	word32 Tag() const {return field.GetReductionMethod() == ModularArithmetic::SPECIAL_FORM ? 3 : 2;}
+	unsigned int Coordinates() const {return 3;}
+	unsigned int CoordinateSize() const {return size;}
+	void EncodeModulus(byte *output) const {field.GetModulus().Encode(output, size);}
+	void Encode(byte *output, const ECPProjectivePoint &P) const
+	{
+		P.x.Encode(output, size);
+		P.y.Encode(output+size, size);
+		P.z.Encode(output+2*size, size);
+	}
+	void Decode(ECPProjectivePoint &P, const byte *input) const
+	{
+		P.x.Decode(input, size);
+		P.y.Decode(input+size, size);
+		P.z.Decode(input+2*size, size);
+		if (P.x >= field.GetModulus() || P.y >= field.GetModulus() || P.z >= field.GetModulus())
+			throw InvalidPrecomputationImage();
+	}
+
+private:
+	const ModularArithmetic &field;
+	unsigned int size;
+};
 NAMESPACE_END
 
 ECP::Point ECP::DecodePoint(const byte *encodedPoint) const
@@ -122,207 +161,310 @@ const ECP::Point& ECP::Double(const Point &P) const
 	return R;
 }
 
-template <class T, class Iterator> void ParallelInvert(const AbstractRing<T> &ring, Iterator begin, Iterator end)
+ProjectiveECP::ProjectiveECP(const ModularArithmetic &field, const Integer &a)
+	: field(field), a(a), one(field.One())
 {
-	unsigned int n = end-begin;
-	if (n == 1)
-		*begin = ring.MultiplicativeInverse(*begin);
-	else if (n > 1)
-	{
-		std::vector<T> vec((n+1)/2);
-		unsigned int i;
-		Iterator it;
-
-		for (i=0, it=begin; i<n/2; i++, it+=2)
-			vec[i] = ring.Multiply(*it, *(it+1));
-		if (n%2 == 1)
-			vec[n/2] = *it;
+	FieldElement three = field.Add(field.Double(one), one);
+	aIsMinus3 = field.Equal(a, field.Inverse(three));
+	aIsZero = !a;
+}
 
-		ParallelInvert(ring, vec.begin(), vec.end());
+ProjectiveECP::Point ProjectiveECP::FromAffine(const ECPPoint &P) const
+{
+	return P.identity ? Zero() : Point(P.x, P.y, one);
+}
 
-		for (i=0, it=begin; i<n/2; i++, it+=2)
-		{
-			if (!vec[i])
-			{
-				*it = ring.MultiplicativeInverse(*it);
-				*(it+1) = ring.MultiplicativeInverse(*(it+1));
-			}
-			else
-			{
-				std::swap(*it, *(it+1));
-				*it = ring.Multiply(*it, vec[i]);
-				*(it+1) = ring.Multiply(*(it+1), vec[i]);
-			}
-		}
-		if (n%2 == 1)
-			*it = vec[n/2];
-	}
+ECPPoint ProjectiveECP::ToAffine(const Point &P) const
+{
+	if (!P.z)
+		return ECPPoint();
+	if (P.z == one)
+		return ECPPoint(P.x, P.y);
+
+	FieldElement zInv = field.MultiplicativeInverse(P.z);
+	FieldElement zInv2 = field.Square(zInv);
+	FieldElement x = field.Multiply(P.x, zInv2);
+	zInv2 = field.Multiply(zInv2, zInv);
+	return ECPPoint(x, field.Multiply(P.y, zInv2));
 }
 
-struct ProjectivePoint
+void ProjectiveECP::Normalize(Point *points, unsigned int count) const
 {
-	ProjectivePoint() {}
-	ProjectivePoint(const Integer &x, const Integer &y, const Integer &z)
-		: x(x), y(y), z(z)	{}
+	std::vector<FieldElement> zInv(count);
+	unsigned int i;
+	for (i=0; i<count; i++)
+		zInv[i] = points[i].z;
 
-	Integer x,y,z;
-};
+	BatchInversion(field, zInv.begin(), zInv.end(), true);
 
-class ProjectiveDoubling
-{
-public:
-	ProjectiveDoubling(const ModularArithmetic &mr, const Integer &a, const Integer &b, const ECPPoint &Q)
-		: mr(mr), firstDoubling(true), negated(false)
+	for (i=0; i<count; i++)
 	{
-		if (Q.identity)
-		{
-			sixteenY4 = P.x = P.y = mr.One();
-			aZ4 = P.z = mr.Zero();
-		}
-		else
-		{
-			P.x = Q.x;
-			P.y = Q.y;
-			sixteenY4 = P.z = mr.One();
-			aZ4 = a;
-		}
+		if (!zInv[i])
+			continue;
+		FieldElement zInv2 = field.Square(zInv[i]);
+		points[i].x = field.Multiply(points[i].x, zInv2);
+		zInv2 = field.Multiply(zInv2, zInv[i]);
+		points[i].y = field.Multiply(points[i].y, zInv2);
+		points[i].z = one;
 	}
+}
 
-	const ProjectivePoint & DoDoublings(unsigned int doublingCount, bool negate)
-	{
-		for (unsigned int i=0; i<doublingCount; i++)
-		{
-			twoY = mr.Double(P.y);
-			P.z = mr.Multiply(P.z, twoY);
-			fourY2 = mr.Square(twoY);
-			S = mr.Multiply(fourY2, P.x);
-			aZ4 = mr.Multiply(aZ4, sixteenY4);
-			M = mr.Square(P.x);
-			M = mr.Add(mr.Add(mr.Double(M), M), aZ4);
-			P.x = mr.Square(M);
-			mr.Reduce(P.x, S);
-			mr.Reduce(P.x, S);
-			mr.Reduce(S, P.x);
-			P.y = mr.Multiply(M, S);
-			sixteenY4 = mr.Square(fourY2);
-			mr.Reduce(P.y, mr.Half(sixteenY4));
-		}
-
-		if (negate != negated)
-		{
-			negated = !negated;
-			P.y = mr.Inverse(P.y);
-		}
+bool ProjectiveECP::Equal(const Point &P, const Point &Q) const
+{
+	if (!P.z || !Q.z)
+		return !P.z && !Q.z;
 
-		return P;
-	}
+	// compare x1*z2^2 with x2*z1^2 and y1*z2^3 with y2*z1^3
+	FieldElement pz2 = field.Square(P.z), qz2 = field.Square(Q.z);
+	FieldElement t1 = field.Multiply(P.x, qz2), t2 = field.Multiply(Q.x, pz2);
+	if (!field.Equal(t1, t2))
+		return false;
+	t1 = field.Multiply(P.y, field.Multiply(qz2, Q.z));
+	t2 = field.Multiply(Q.y, field.Multiply(pz2, P.z));
+	return field.Equal(t1, t2);
+}
 
-	const ModularArithmetic &mr;
-	ProjectivePoint P;
-	bool firstDoubling, negated;
-	Integer sixteenY4, aZ4, twoY, fourY2, S, M;
-};
+const ProjectiveECP::Point& ProjectiveECP::Zero() const
+{
+	static const Point zero(Integer::One(), Integer::One(), Integer::Zero());
+	return zero;
+}
 
-struct ZIterator
+const ProjectiveECP::Point& ProjectiveECP::Inverse(const Point &P) const
 {
-	ZIterator() {}
-	ZIterator(std::vector<ProjectivePoint>::iterator it) : it(it) {}
-	Integer& operator*() {return it->z;}
-	int operator-(ZIterator it2) {return it-it2.it;}
-	ZIterator operator+(int i) {return ZIterator(it+i);}
-	ZIterator& operator+=(int i) {it+=i; return *this;}
-	std::vector<ProjectivePoint>::iterator it;
-};
+	R.x = P.x;
+	R.y = field.Inverse(P.y);
+	R.z = P.z;
+	return R;
+}
 
-ECP::Point ECP::ScalarMultiply(const Point &P, const Integer &k) const
+const ProjectiveECP::Point& ProjectiveECP::Add(const Point &P, const Point &Q) const
 {
-	const int windowSize = 5;
-	const word windowModulus = 1 << windowSize;
+	if (!P.z) return Q;
+	if (!Q.z) return P;
+	if (P.z == one && Q.z != one)
+		return Add(Q, P);
+
+	// with Q.z == 1 (mixed addition) this costs 8 multiplications and 3 squarings, otherwise 12 and 4
+	FieldElement u1, s1, u2, s2;
+	const bool mixed = Q.z == one;
+	FieldElement pz2 = field.Square(P.z);
+	u2 = field.Multiply(Q.x, pz2);
+	s2 = field.Multiply(Q.y, field.Multiply(pz2, P.z));
+	if (mixed)
+	{
+		u1 = P.x;
+		s1 = P.y;
+	}
+	else
+	{
+		FieldElement qz2 = field.Square(Q.z);
+		u1 = field.Multiply(P.x, qz2);
+		s1 = field.Multiply(P.y, field.Multiply(qz2, Q.z));
+	}
 
-	if (k.BitCount() <= windowSize)
-		return AbstractGroup<ECPPoint>::ScalarMultiply(P, k);
+	FieldElement h = field.Subtract(u2, u1);
+	FieldElement r = field.Subtract(s2, s1);
+	if (!h)
+		return !r ? Double(P) : Zero();
+
+	FieldElement h2 = field.Square(h);
+	FieldElement h3 = field.Multiply(h2, h);
+	FieldElement v = field.Multiply(u1, h2);
+
+	FieldElement x = field.Square(r);
+	field.Reduce(x, h3);
+	field.Reduce(x, field.Double(v));
+	field.Reduce(v, x);
+	R.y = field.Multiply(r, v);
+	field.Reduce(R.y, field.Multiply(s1, h3));
+	R.z = mixed ? field.Multiply(P.z, h) : field.Multiply(field.Multiply(P.z, Q.z), h);
+	R.x.swap(x);
+	return R;
+}
 
-	ProjectiveDoubling rd(field, a, b, P);
-	std::vector<word> exponents;
-	std::vector<ProjectivePoint> bases;
-	Integer workExponent = k;
-	int futureDoublings = 0, skipCount;
+const ProjectiveECP::Point& ProjectiveECP::Double(const Point &P) const
+{
+	if (!P.z || !P.y)
+		return Zero();
 
-	while (!!workExponent)
+	// m = 3*x^2 + a*z^4, which is 3*(x-z^2)*(x+z^2) if a == -3
+	FieldElement m, z2;
+	if (aIsMinus3)
+	{
+		z2 = field.Square(P.z);
+		FieldElement t = field.Add(P.x, z2);
+		m = field.Multiply(field.Subtract(P.x, z2), t);
+		m = field.Add(field.Double(m), m);
+	}
+	else
 	{
-		for (skipCount=0; ; skipCount++)
-			if (workExponent.GetBit(skipCount))
-				break;
-		workExponent >>= skipCount;
-		
-		word subExponent = workExponent % windowModulus;
-		workExponent >>= windowSize;
-		if (workExponent.IsOdd())
+		m = field.Square(P.x);
+		m = field.Add(field.Double(m), m);
+		if (!aIsZero)
 		{
-			subExponent = windowModulus - subExponent;
-			++workExponent;
-			bases.push_back(rd.DoDoublings(futureDoublings+skipCount, true));
+			z2 = field.Square(P.z);
+			field.Accumulate(m, field.Multiply(a, field.Square(z2)));
 		}
-		else
-			bases.push_back(rd.DoDoublings(futureDoublings+skipCount, false));
-
-		exponents.push_back(subExponent);
-		futureDoublings = windowSize;
 	}
 
-	std::vector<std::pair<Integer, Point> > finalCascade(bases.size());
+	FieldElement y2 = field.Square(P.y);
+	FieldElement s = field.Multiply(P.x, y2);
+	s = field.Double(field.Double(s));
+	FieldElement y4 = field.Square(y2);
+	y4 = field.Double(field.Double(field.Double(y4)));
+
+	R.z = field.Multiply(P.y, P.z);
+	R.z = field.Double(R.z);
+	FieldElement x = field.Square(m);
+	field.Reduce(x, field.Double(s));
+	field.Reduce(s, x);
+	R.y = field.Multiply(m, s);
+	field.Reduce(R.y, y4);
+	R.x.swap(x);
+	return R;
+}
 
-	ParallelInvert(field, ZIterator(bases.begin()), ZIterator(bases.end()));
+ProjectiveECP::Point ProjectiveECP::ScalarMultiply(const Point &P, const Integer &k) const
+{
+	std::pair<Integer, Point> pair(k, P);
+	return InterleavedWindowMultiplication(*this, &pair, &pair+1);
+}
 
-	for (int i=0; i<finalCascade.size(); i++)
-	{
-		finalCascade[i].first = exponents[i];
-		if (!!bases[i].z)
-		{
-			finalCascade[i].second.identity = false;
-			finalCascade[i].second.x = field.Square(bases[i].z);
-			finalCascade[i].second.y = field.Multiply(finalCascade[i].second.x, bases[i].z);
-			finalCascade[i].second.x = field.Multiply(finalCascade[i].second.x, bases[i].x);
-			finalCascade[i].second.y = field.Multiply(finalCascade[i].second.y, bases[i].y);
-		}
-	}
+ProjectiveECP::Point ProjectiveECP::CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const
+{
+	std::pair<Integer, Point> pairs[2] = {std::make_pair(k1, P), std::make_pair(k2, Q)};
+	return InterleavedWindowMultiplication(*this, pairs, pairs+2);
+}
+
+// ********************************************************
+
+ECP::Point ECP::ScalarMultiply(const Point &P, const Integer &k) const
+{
+	member_ptr<Field> f(field.Clone());
+	ProjectiveECP pecp(*f, a);
+	return pecp.ToAffine(pecp.ScalarMultiply(pecp.FromAffine(P), k));
+}
 
-	return GeneralCascadeMultiplication(*this, finalCascade.begin(), finalCascade.end());
+ECP::Point ECP::CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const
+{
+	member_ptr<Field> f(field.Clone());
+	ProjectiveECP pecp(*f, a);
+	return pecp.ToAffine(pecp.CascadeScalarMultiply(pecp.FromAffine(P), k1, pecp.FromAffine(Q), k2));
 }
 
 ECP::Point ECP::Multiply(const Integer &k, const Point &P) const
 {
-//	return ScalarMultiply(P, k);
+	// a special form modulus reduces faster than Montgomery representation,
+	// P may come from DecodePoint() with coordinates that are not reduced
+	if (field.GetReductionMethod() == ModularArithmetic::SPECIAL_FORM)
+		return ScalarMultiply(ToField(field, P), k);
+
 	MontgomeryRepresentation mr(field.GetModulus());
 	ECP ecpmr(mr, mr.ConvertIn(a), mr.ConvertIn(b));
-	return FromMontgomery(mr, ecpmr.ScalarMultiply(ToMontgomery(mr, P), k));
+	return FromField(mr, ecpmr.ScalarMultiply(ToField(mr, P), k));
 }
 
 ECP::Point ECP::CascadeMultiply(const Integer &k1, const Point &P, const Integer &k2, const Point &Q) const
 {
-//	return CascadeMultiplication(*this, P, k1, Q, k2);
+	if (field.GetReductionMethod() == ModularArithmetic::SPECIAL_FORM)
+		return CascadeScalarMultiply(ToField(field, P), k1, ToField(field, Q), k2);
+
 	MontgomeryRepresentation mr(field.GetModulus());
 	ECP ecpmr(mr, mr.ConvertIn(a), mr.ConvertIn(b));
-	return FromMontgomery(mr, ecpmr.CascadeScalarMultiply(ToMontgomery(mr, P), k1, ToMontgomery(mr, Q), k2));
+	return FromField(mr, ecpmr.CascadeScalarMultiply(ToField(mr, P), k1, ToField(mr, Q), k2));
+}
+
+// ********************************************************
+
+struct ECPNamedCurveParameters
+{
+	const char *name, *p, *b, *x, *y, *n;
+};
+
+static const ECPNamedCurveParameters s_namedCurves[] =
+{
+	{"P-192",
+	 "0xfffffffffffffffffffffffffffffffeffffffffffffffff",
+	 "0x64210519e59c80e70fa7e9ab72243049feb8deecc146b9b1",
+	 "0x188da80eb03090f67cbf20eb43a18800f4ff0afd82ff1012",
+	 "0x07192b95ffc8da78631011ed6b24cdd573f977a11e794811",
+	 "0xffffffffffffffffffffffff99def836146bc9b1b4d22831"},
+	{"P-224",
+	 "0xffffffffffffffffffffffffffffffff000000000000000000000001",
+	 "0xb4050a850c04b3abf54132565044b0b7d7bfd8ba270b39432355ffb4",
+	 "0xb70e0cbd6bb4bf7f321390b94a03c1d356c21122343280d6115c1d21",
+	 "0xbd376388b5f723fb4c22dfe6cd4375a05a07476444d5819985007e34",
+	 "0xffffffffffffffffffffffffffff16a2e0b8f03e13dd29455c5c2a3d"},
+	{"P-256",
+	 "0xffffffff00000001000000000000000000000000ffffffffffffffffffffffff",
+	 "0x5ac635d8aa3a93e7b3ebbd55769886bc651d06b0cc53b0f63bce3c3e27d2604b",
+	 "0x6b17d1f2e12c4247f8bce6e563a440f277037d812deb33a0f4a13945d898c296",
+	 "0x4fe342e2fe1a7f9b8ee7eb4a7c0f9e162bce33576b315ececbb6406837bf51f5",
+	 "0xffffffff00000000ffffffffffffffffbce6faada7179e84f3b9cac2fc632551"},
+	{"P-384",
+	 "0xfffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffeffffffff0000000000000000ffffffff",
+	 "0xb3312fa7e23ee7e4988e056be3f82d19181d9c6efe8141120314088f5013875ac656398d8a2ed19d2a85c8edd3ec2aef",
+	 "0xaa87ca22be8b05378eb1c71ef320ad746e1d3b628ba79b9859f741e082542a385502f25dbf55296c3a545e3872760ab7",
+	 "0x3617de4a96262c6f5d9e98bf9292dc29f8f41dbd289a147ce9da3113b5f0b8c00a60b1ce1d7e819d7a431d7c90ea0e5f",
+	 "0xffffffffffffffffffffffffffffffffffffffffffffffffc7634d81f4372ddf581a0db248b0a77aecec196accc52973"},
+	{"P-521",
+	 "0x1ffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff",
+	 "0x051953eb9618e1c9a1f929a21a0b68540eea2da725b99b315f3b8b489918ef109e156193951ec7e937b1652c0bd3bb1bf073573df883d2c34f1ef451fd46b503f00",
+	 "0xc6858e06b70404e9cd9e3ecb662395b4429c648139053fb521f828af606b4d3dbaa14b5e77efe75928fe1dc127a2ffa8de3348b3c1856a429bf97e7e31c2e5bd66",
+	 "0x11839296a789a3bc0045c8a5fb42c7d1bd998f54449579b446817afbd17273e662c97ee72995ef42640c550b9013fad0761353c7086a272c24088be94769fd16650",
+	 "0x1fffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffa51868783bf2f966b7fcc0148f709a5d03bb5c9b8899c47aebb6fb71e91386409"}
+};
+
+ECPNamedCurve::ECPNamedCurve(const char *name)
+{
+	for (unsigned int i=0; i<sizeof(s_namedCurves)/sizeof(s_namedCurves[0]); i++)
+		if (strcmp(name, s_namedCurves[i].name) == 0)
+		{
+			Initialize(ID(i));
+			return;
+		}
+	throw UnknownName();
+}
+
+const char * ECPNamedCurve::GetName() const
+{
+	return s_namedCurves[id].name;
+}
+
+void ECPNamedCurve::Initialize(ID id)
+{
+	const ECPNamedCurveParameters &param = s_namedCurves[id];
+	const Integer p(param.p);
+
+	this->id = id;
+	ec.reset(new ECP(p, p-Integer(3L), Integer(param.b)));
+	G = ECP::Point(Integer(param.x), Integer(param.y));
+	n = Integer(param.n);
 }
 
 // ********************************************************
 
 EcPrecomputation<ECP>::EcPrecomputation()
+	: combTeeth(DEFAULT_COMB_TEETH)
 {
 }
 
 EcPrecomputation<ECP>::EcPrecomputation(const EcPrecomputation<ECP> &ecp)
-	: mr(new MontgomeryRepresentation(*ecp.mr))
-	, ec(new ECP(*mr, ecp.ec->GetA(), ecp.ec->GetB()))
-	, ep(new ExponentiationPrecomputation<ECP::Point>(*ec, *ecp.ep))
+	: field(NewFastestField(ecp.field->GetModulus()))
+	, ec(new ECP(*field, ecp.ec->GetA(), ecp.ec->GetB()))
+	, pec(new ProjectiveECP(*field, ec->GetA()))
+	, ep(new ExponentiationPrecomputation<ECPProjectivePoint>(*pec, *ecp.ep))
+	, combTeeth(ecp.combTeeth)
 {
 }
 
-EcPrecomputation<ECP>::EcPrecomputation(const ECP &ecIn, const ECP::Point &base, unsigned int maxExpBits, unsigned int storage)
-	: mr(new MontgomeryRepresentation(ecIn.GetField().GetModulus()))
-	, ec(new ECP(*mr, mr->ConvertIn(ecIn.GetA()), mr->ConvertIn(ecIn.GetB())))
+EcPrecomputation<ECP>::EcPrecomputation(const ECP &ecIn, const ECP::Point &base, unsigned int maxExpBits, unsigned int storage, unsigned int teeth)
+	: field(NewFastestField(ecIn.GetField().GetModulus()))
+	, ec(new ECP(*field, field->ConvertIn(ecIn.GetA()), field->ConvertIn(ecIn.GetB())))
+	, pec(new ProjectiveECP(*field, ec->GetA()))
 	, ep(NULL)
+	, combTeeth(teeth)
 {
 	Precompute(base, maxExpBits, storage);
 }
@@ -333,24 +475,58 @@ EcPrecomputation<ECP>::~EcPrecomputation()
 
 void EcPrecomputation<ECP>::Precompute(const ECP::Point &base, unsigned int maxExpBits, unsigned int storage)
 {
-	ep.reset(new ExponentiationPrecomputation<ECP::Point>(*ec, ToMontgomery(*mr, base), maxExpBits, storage));
+	ep.reset(new ExponentiationPrecomputation<ECPProjectivePoint>(*pec, pec->FromAffine(ToField(*field, base)), maxExpBits, storage));
+	pec->Normalize(&ep->g[0], ep->g.size());
+	PrecomputeComb();
 }
 
 void EcPrecomputation<ECP>::Load(BufferedTransformation &bt)
 {
-	ep.reset(new ExponentiationPrecomputation<ECP::Point>(*ec));
+	ep.reset(new ExponentiationPrecomputation<ECPProjectivePoint>(*pec));
 	BERSequenceDecoder seq(bt);
 	ep->storage = (unsigned int)(Integer(seq).ConvertToLong());
 	ep->exponentBase.BERDecode(seq);
 	ep->g.resize(ep->storage);
 
+	// the stored points are in Montgomery representation, whichever field is used here
+	const bool convert = field->GetReductionMethod() == ModularArithmetic::SPECIAL_FORM;
+	MontgomeryRepresentation mr(convert ? field->GetModulus() : Integer::One());
 	for (unsigned i=0; i<ep->storage; i++)
 	{
-		ep->g[i].identity = false;
-		ep->g[i].x.BERDecode(seq);
-		ep->g[i].y.BERDecode(seq);
+		ECP::Point P;
+		P.identity = false;
+		P.x.BERDecode(seq);
+		P.y.BERDecode(seq);
+		if (P.x.IsNegative() || P.x >= field->GetModulus() || P.y.IsNegative() || P.y >= field->GetModulus())
+			BERDecodeError();
+		ep->g[i] = pec->FromAffine(convert ? ToField(*field, FromField(mr, P)) : P);
 	}
 	seq.OutputFinished();
+	PrecomputeComb();
+}
+
+void EcPrecomputation<ECP>::SetCombTeeth(unsigned int teeth)
+{
+	combTeeth = teeth;
+	if (ep.get())
+		PrecomputeComb();
+}
+
+unsigned int EcPrecomputation<ECP>::Storage() const
+{
+	return ep.get() ? ep->storage : 0;
+}
+
+bool EcPrecomputation<ECP>::HasCombTables() const
+{
+	return ep.get() && !ep->comb.empty();
+}
+
+void EcPrecomputation<ECP>::PrecomputeComb()
+{
+	ep->PrecomputeComb(combTeeth);
+	if (!ep->comb.empty())
+		pec->Normalize(&ep->comb[0], ep->comb.size());
 }
 
 void EcPrecomputation<ECP>::Save(BufferedTransformation &bt) const
@@ -360,24 +536,45 @@ void EcPrecomputation<ECP>::Save(BufferedTransformation &bt) const
 	Integer(ep->storage).DEREncode(seq);
 	ep->exponentBase.DEREncode(seq);
 
+	const bool convert = field->GetReductionMethod() == ModularArithmetic::SPECIAL_FORM;
+	MontgomeryRepresentation mr(convert ? field->GetModulus() : Integer::One());
 	for (unsigned i=0; i<ep->storage; i++)
 	{
-		ep->g[i].x.DEREncode(seq);
-		ep->g[i].y.DEREncode(seq);
+		ECP::Point P(ep->g[i].x, ep->g[i].y);
+		if (convert)
+			P = ToField(mr, FromField(*field, P));
+		P.x.DEREncode(seq);
+		P.y.DEREncode(seq);
 	}
 	seq.InputFinished();
 }
 
+void EcPrecomputation<ECP>::SaveImage(BufferedTransformation &bt) const
+{
+	assert(ep.get());
+	SavePrecomputationImage(bt, *ep, ECPImageCodec(*field));
+}
+
+unsigned int EcPrecomputation<ECP>::LoadImage(const byte *image, unsigned int length)
+{
+	ep.reset(new ExponentiationPrecomputation<ECPProjectivePoint>(*pec));
+	return LoadPrecomputationImage(*ep, image, length, ECPImageCodec(*field));
+}
+
 ECP::Point EcPrecomputation<ECP>::Multiply(const Integer &exponent) const
 {
 	assert(ep.get());
-	return FromMontgomery(*mr, ep->Exponentiate(exponent));
+	member_ptr<ModularArithmetic> f(field->Clone());
+	ProjectiveECP pec(*f, ec->GetA());
+	return FromField(*f, pec.ToAffine(ep->Exponentiate(pec, exponent)));
 }
 
 ECP::Point EcPrecomputation<ECP>::CascadeMultiply(const Integer &exponent, const EcPrecomputation<ECP> &pc2, const Integer &exponent2) const
 {
 	assert(ep.get());
-	return FromMontgomery(*mr, ep->CascadeExponentiate(exponent, *pc2.ep, exponent2));
+	member_ptr<ModularArithmetic> f(field->Clone());
+	ProjectiveECP pec(*f, ec->GetA());
+	return FromField(*f, pec.ToAffine(ep->CascadeExponentiate(pec, exponent, *pc2.ep, exponent2)));
 }
 
 NAMESPACE_END
@@ -32,17 +32,24 @@ public:
 
 	ECP(const Integer &modulus, const FieldElement &a, const FieldElement &b)
 		: fieldPtr(new Field(modulus)), field(*fieldPtr), a(a), b(b) {}
-	ECP(const MontgomeryRepresentation &mr, const FieldElement &a, const FieldElement &b)
-		: field(mr), a(a), b(b) {}
+	// a and b must be in field's representation, which must outlive this object
+	ECP(const Field &field, const FieldElement &a, const FieldElement &b)
+		: field(field), a(a), b(b) {}
 	ECP(const ECP &ecp)
-		: fieldPtr(new Field(ecp.field.GetModulus())), field(*fieldPtr), a(ecp.a), b(ecp.b) {}
+		: fieldPtr(ecp.field.Clone()), field(*fieldPtr), a(ecp.a), b(ecp.b) {}
 
+	// Add(), Double() and Inverse() return results kept in this object and its field, so only
+	// one thread at a time may call them, the multiplications and the other functions below
+	// work in a copy of the field and may be called from several threads at once
 	bool Equal(const Point &P, const Point &Q) const;
 	const Point& Zero() const {static const Point zero; return zero;}
 	const Point& Inverse(const Point &P) const;
+	bool InversionIsFast() const {return true;}
 	const Point& Add(const Point &P, const Point &Q) const;
 	const Point& Double(const Point &P) const;
+	// these two work in Jacobian coordinates internally, see ProjectiveECP
 	Point ScalarMultiply(const Point &P, const Integer &k) const;
+	Point CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const;
 	Point Multiply(const Integer &k, const Point &P) const;
 	Point CascadeMultiply(const Integer &k1, const Point &P, const Integer &k2, const Point &Q) const;
 
@@ -66,6 +73,83 @@ private:
 	mutable Point R;
 };
 
+// the point (x/z^2, y/z^3) in Jacobian coordinates, z is 0 for the point at infinity
+struct ECPProjectivePoint
+{
+	ECPProjectivePoint() {}
+	ECPProjectivePoint(const Integer &x, const Integer &y, const Integer &z)
+		: x(x), y(y), z(z) {}
+
+	Integer x, y, z;
+};
+
+// the points of an ECP in Jacobian coordinates, where Add() and Double() don't need a
+// field inversion, Add() is cheapest if its second argument has z == 1 (mixed addition)
+class ProjectiveECP : public AbstractGroup<ECPProjectivePoint>
+{
+public:
+	typedef ModularArithmetic Field;
+	typedef Integer FieldElement;
+
+	typedef ECPProjectivePoint Point;
+
+	ProjectiveECP(const Field &field, const FieldElement &a);
+
+	Point FromAffine(const ECPPoint &P) const;
+	ECPPoint ToAffine(const Point &P) const;
+	// sets z = 1 in each of points[0..count), using one field inversion in all
+	void Normalize(Point *points, unsigned int count) const;
+
+	bool Equal(const Point &P, const Point &Q) const;
+	const Point& Zero() const;
+	const Point& Inverse(const Point &P) const;
+	bool InversionIsFast() const {return true;}
+	const Point& Add(const Point &P, const Point &Q) const;
+	const Point& Double(const Point &P) const;
+	Point ScalarMultiply(const Point &P, const Integer &k) const;
+	Point CascadeScalarMultiply(const Point &P, const Integer &k1, const Point &Q, const Integer &k2) const;
+
+private:
+	const Field &field;
+	FieldElement a, one;
+	bool aIsMinus3, aIsZero;
+	mutable Point R;
+};
+
+// the recommended curves over prime fields from FIPS 186-2 appendix 6, which all have a == -3
+// and cofactor 1, and whose moduli have the special forms reduced by NISTPrimeReducer
+// (P-521 by PseudoMersenneReducer)
+class ECPNamedCurve
+{
+public:
+	enum ID {P192, P224, P256, P384, P521};
+
+	class UnknownName : public Exception
+	{
+	public:
+		UnknownName() : Exception("ECPNamedCurve: unknown curve name") {}
+	};
+
+	ECPNamedCurve(ID id) {Initialize(id);}
+	// name is one of "P-192", "P-224", "P-256", "P-384" and "P-521", throws UnknownName otherwise
+	ECPNamedCurve(const char *name);
+
+	ID GetID() const {return id;}
+	const char * GetName() const;
+
+	const ECP& GetCurve() const {return *ec;}
+	const ECP::Point& GetBasePoint() const {return G;}
+	const Integer& GetBasePointOrder() const {return n;}
+
+private:
+	void Initialize(ID id);
+
+	ID id;
+	value_ptr<ECP> ec;
+	ECP::Point G;
+	Integer n;
+};
+
 template <class T> class EcPrecomputation;
 
 template<> class EcPrecomputation<ECP>
@@ -73,20 +157,37 @@ template<> class EcPrecomputation<ECP>
 public:
 	EcPrecomputation();
 	EcPrecomputation(const EcPrecomputation<ECP> &ecp);
-	EcPrecomputation(const ECP &ecIn, const ECP::Point &base, unsigned int maxExpBits, unsigned int storage);
+	EcPrecomputation(const ECP &ecIn, const ECP::Point &base, unsigned int maxExpBits, unsigned int storage, unsigned int combTeeth=DEFAULT_COMB_TEETH);
 	~EcPrecomputation();
 
 	void Precompute(const ECP::Point &base, unsigned int maxExpBits, unsigned int storage);
 	void Load(BufferedTransformation &storedPrecomputation);
 	void Save(BufferedTransformation &storedPrecomputation) const;
+	// a fixed-layout image of the points including the comb tables, which LoadImage() reads without
+	// parsing, for sharing a precomputation between processes through a file they map read-only
+	void SaveImage(BufferedTransformation &storedPrecomputation) const;
+	// returns the number of bytes of image read, throws InvalidPrecomputationImage if it doesn't fit the curve,
+	// and uses the comb tables in the image, SetCombTeeth() only applies to tables built here
+	unsigned int LoadImage(const byte *image, unsigned int length);
+
+	// Multiply() and CascadeMultiply() use fixed-base comb tables of about (storage/teeth)*2^teeth
+	// points built from the stored ones, more teeth trade memory for speed, 0 turns the tables off
+	void SetCombTeeth(unsigned int teeth);
+	// the number of precomputed multiples of the base, 0 if there are none yet
+	unsigned int Storage() const;
+	bool HasCombTables() const;
 
 	ECP::Point Multiply(const Integer &exponent) const;
 	ECP::Point CascadeMultiply(const Integer &exponent, const EcPrecomputation<ECP> &pc2, const Integer &exponent2) const;
 
 private:
-	member_ptr<MontgomeryRepresentation> mr;
+	void PrecomputeComb();
+
+	member_ptr<ModularArithmetic> field;	// Montgomery representation unless the modulus has a special form
 	member_ptr<ECP> ec;
-	member_ptr< ExponentiationPrecomputation<ECP::Point> > ep;
+	member_ptr<ProjectiveECP> pec;
+	member_ptr< ExponentiationPrecomputation<ECPProjectivePoint> > ep;	// the bases and comb tables have z == 1
+	unsigned int combTeeth;
 };
 
 NAMESPACE_END
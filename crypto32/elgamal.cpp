@@ -153,10 +153,12 @@ unsigned int ElGamalDecryptor::Decrypt(const byte *cipherText, byte *plainText)
 
 void ElGamalDecryptor::RawDecrypt(const Integer &a, const Integer &b, Integer &m) const
 {
+	MontgomeryRepresentation mr(gpc.GetMontgomeryRepresentation());
+	const Integer ma = mr.ConvertIn(a);
 	if (x.BitCount()+20 < p.BitCount()) // if x is short
-		m = b * EuclideanMultiplicativeInverse(a_exp_b_mod_c(a, x, p), p) % p;
+		m = b * EuclideanMultiplicativeInverse(mr.ConvertOut(mr.FixedWindowExponentiate(ma, x, x.BitCount())), p) % p;
 	else	// save a multiplicative inverse calculation
-		m = b * a_exp_b_mod_c(a, p-1-x, p) % p;
+		m = b * mr.ConvertOut(mr.FixedWindowExponentiate(ma, p-1-x, p.BitCount())) % p;
 }
 
 NAMESPACE_END
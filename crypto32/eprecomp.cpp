@@ -13,8 +13,64 @@ template <class T> void ExponentiationPrecomputation<T>::Precompute(const Elemen
 		g[i] = group.ScalarMultiply(g[i-1], exponentBase);
 }
 
-template <class T> ExponentiationPrecomputation<T>::Element ExponentiationPrecomputation<T>::Exponentiate(const Integer &exponent) const
+template <class T> void ExponentiationPrecomputation<T>::PrecomputeComb(unsigned int teeth)
 {
+	// with a single base the comb is just binary double-and-add, which is slower than the windows of Exponentiate()
+	combTeeth = storage > 1 ? STDMIN(STDMIN(teeth, storage), MAX_COMB_TEETH) : 0;
+	comb.clear();
+	if (!combTeeth)
+		return;
+
+	const unsigned int tableSize = (1U << combTeeth) - 1;
+	const unsigned int lastGroup = (storage-1)/combTeeth;
+	comb.resize(lastGroup*tableSize + (1U << (storage-lastGroup*combTeeth)) - 1);
+
+	for (unsigned int i=0; i<storage; i++)
+	{
+		// the sums containing base i are those of the earlier bases in the run plus base i
+		const unsigned int offset = i/combTeeth*tableSize, bit = 1U << (i%combTeeth);
+		comb[offset+bit-1] = g[i];
+		for (unsigned int u=1; u<bit; u++)
+			comb[offset+bit+u-1] = group.Add(comb[offset+u-1], g[i]);
+	}
+}
+
+template <class T> bool ExponentiationPrecomputation<T>::CombApplies(const Integer &exponent) const
+{
+	return combTeeth && exponent.NotNegative() && exponent.BitCount() <= storage*(exponentBase.BitCount()-1);
+}
+
+// adds to result the comb table entries selected by bit column of each of the exponent's segments
+template <class T> void ExponentiationPrecomputation<T>::AccumulateComb(const Group &group, Element &result, bool &empty, const Integer &exponent, unsigned int column) const
+{
+	const unsigned int segmentBits = exponentBase.BitCount()-1, tableSize = (1U << combTeeth) - 1;
+	unsigned int i = 0;
+
+	for (unsigned int offset=0; i<storage; offset+=tableSize)
+	{
+		unsigned int u = 0;
+		for (unsigned int t=0; t<combTeeth && i<storage; t++, i++)
+			u |= (unsigned int)exponent.GetBit(i*segmentBits+column) << t;
+		if (u)
+			AccumulateTo(group, result, empty, comb[offset+u-1]);
+	}
+}
+
+template <class T> ExponentiationPrecomputation<T>::Element ExponentiationPrecomputation<T>::Exponentiate(const Group &group, const Integer &exponent) const
+{
+	if (CombApplies(exponent))
+	{
+		Element result = group.Zero();
+		bool empty = true;
+		for (unsigned int k=exponentBase.BitCount()-1; k--; )
+		{
+			if (!empty)
+				result = group.Double(result);
+			AccumulateComb(group, result, empty, exponent, k);
+		}
+		return result;
+	}
+
 	std::vector<std::pair<Integer, Element> > eb(storage);	// array of segments of the exponent and precalculated bases
 	Integer temp, e = exponent;
 	unsigned i;
@@ -32,9 +88,27 @@ template <class T> ExponentiationPrecomputation<T>::Element ExponentiationPrecom
 }
 
 template <class T> T 
-	ExponentiationPrecomputation<T>::CascadeExponentiate(const Integer &exponent, 
+	ExponentiationPrecomputation<T>::CascadeExponentiate(const Group &group, const Integer &exponent, 
 		const ExponentiationPrecomputation<T> &pc2, const Integer &exponent2) const
 {
+	const bool comb = CombApplies(exponent), comb2 = pc2.CombApplies(exponent2);
+	if (comb && comb2 && exponentBase == pc2.exponentBase)
+	{
+		// share the doublings between the two combs
+		Element result = group.Zero();
+		bool empty = true;
+		for (unsigned int k=exponentBase.BitCount()-1; k--; )
+		{
+			if (!empty)
+				result = group.Double(result);
+			AccumulateComb(group, result, empty, exponent, k);
+			pc2.AccumulateComb(group, result, empty, exponent2, k);
+		}
+		return result;
+	}
+	if (comb || comb2)
+		return group.Add(Exponentiate(group, exponent), pc2.Exponentiate(group, exponent2));
+
 	std::vector<std::pair<Integer, Element> > eb(storage+pc2.storage);	// array of segments of the exponent and precalculated bases
 	Integer temp, e = exponent;
 	unsigned i;
@@ -61,4 +135,106 @@ template <class T> T
 	return GeneralCascadeMultiplication<Element>(group, eb.begin(), eb.end());
 }
 
+// ********************************************************
+
+// SaveImage() and LoadImage() of the public classes store an ExponentiationPrecomputation in a fixed
+// layout: PRECOMPUTATION_IMAGE_HEADER_FIELDS 32-bit big-endian fields, then exponentBase, the modulus,
+// and every element of g and comb, each element as a fixed number of big-endian coordinates of the
+// same size. Unlike Save(), which DER encodes only g, the image includes the comb tables and element
+// i sits at a fixed offset, so an image mapped read-only into memory loads with one pass of copying.
+// Codec gives a tag for the element type and representation, Coordinates(), CoordinateSize(),
+// EncodeModulus(), and Encode() and Decode() of an element.
+
+const word32 PRECOMPUTATION_IMAGE_MAGIC = 0x45504931;	// "EPI1"
+const unsigned int PRECOMPUTATION_IMAGE_HEADER_FIELDS = 8;
+
+template <class T, class Codec> void SavePrecomputationImage(BufferedTransformation &bt, const ExponentiationPrecomputation<T> &ep, const Codec &codec)
+{
+	const unsigned int coordinateSize = codec.CoordinateSize(), elementSize = codec.Coordinates()*coordinateSize;
+	const unsigned int exponentBaseSize = ep.exponentBase.MinEncodedSize();
+
+	const word32 header[PRECOMPUTATION_IMAGE_HEADER_FIELDS] = {PRECOMPUTATION_IMAGE_MAGIC, codec.Tag(),
+		codec.Coordinates(), coordinateSize, ep.storage, exponentBaseSize, ep.combTeeth, ep.comb.size()};
+	for (unsigned int i=0; i<PRECOMPUTATION_IMAGE_HEADER_FIELDS; i++)
+		bt.PutLong(header[i]);
+
+	SecByteBlock buf(STDMAX(exponentBaseSize, elementSize));
+	ep.exponentBase.Encode(buf, exponentBaseSize);
+	bt.Put(buf, exponentBaseSize);
+	codec.EncodeModulus(buf);
+	bt.Put(buf, coordinateSize);
+
+	unsigned int i;
+	for (i=0; i<ep.storage; i++)
+	{
+		codec.Encode(buf, ep.g[i]);
+		bt.Put(buf, elementSize);
+	}
+	for (i=0; i<ep.comb.size(); i++)
+	{
+		codec.Encode(buf, ep.comb[i]);
+		bt.Put(buf, elementSize);
+	}
+}
+
+// returns the number of bytes of the image read, so that images can be concatenated
+template <class T, class Codec> unsigned int LoadPrecomputationImage(ExponentiationPrecomputation<T> &ep, const byte *image, unsigned int length, const Codec &codec)
+{
+	const unsigned int coordinateSize = codec.CoordinateSize(), elementSize = codec.Coordinates()*coordinateSize;
+	const unsigned int headerSize = 4*PRECOMPUTATION_IMAGE_HEADER_FIELDS;
+
+	word32 header[PRECOMPUTATION_IMAGE_HEADER_FIELDS];
+	if (length < headerSize)
+		throw InvalidPrecomputationImage();
+	GetUserKeyBigEndian(header, PRECOMPUTATION_IMAGE_HEADER_FIELDS, image, headerSize);
+
+	const word32 storage = header[4], exponentBaseSize = header[5], combTeeth = header[6], combCount = header[7];
+	if (header[0] != PRECOMPUTATION_IMAGE_MAGIC || header[1] != codec.Tag() || header[2] != codec.Coordinates()
+		|| header[3] != coordinateSize || storage == 0 || combTeeth > storage || combTeeth > MAX_COMB_TEETH)
+		throw InvalidPrecomputationImage();
+
+	// sizes are checked one at a time so that a corrupt header can't overflow the total
+	const byte *p = image + headerSize;
+	unsigned int left = length - headerSize;
+	if (exponentBaseSize > left || coordinateSize > left - exponentBaseSize)
+		throw InvalidPrecomputationImage();
+	ep.exponentBase.Decode(p, exponentBaseSize);
+	p += exponentBaseSize;
+	if (ep.exponentBase.BitCount() < 2)
+		throw InvalidPrecomputationImage();
+
+	SecByteBlock modulus(coordinateSize);
+	codec.EncodeModulus(modulus);
+	if (memcmp(p, modulus, coordinateSize) != 0)
+		throw InvalidPrecomputationImage();
+	p += coordinateSize;
+	left -= exponentBaseSize + coordinateSize;
+
+	if (storage > left/elementSize)
+		throw InvalidPrecomputationImage();
+
+	// the comb tables must be the size PrecomputeComb() makes them
+	word64 expectedCombCount = 0;
+	if (combTeeth)
+	{
+		const word32 lastGroup = (storage-1)/combTeeth;
+		expectedCombCount = word64(lastGroup)*((word64(1) << combTeeth) - 1) + (word64(1) << (storage-lastGroup*combTeeth)) - 1;
+	}
+	if (combCount != expectedCombCount || combCount > left/elementSize - storage)
+		throw InvalidPrecomputationImage();
+
+	unsigned int i;
+	ep.storage = storage;
+	ep.g.resize(storage);
+	for (i=0; i<storage; i++, p+=elementSize)
+		codec.Decode(ep.g[i], p);
+
+	ep.combTeeth = combTeeth;
+	ep.comb.resize(combCount);
+	for (i=0; i<combCount; i++, p+=elementSize)
+		codec.Decode(ep.comb[i], p);
+
+	return p - image;
+}
+
 NAMESPACE_END
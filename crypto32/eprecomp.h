@@ -15,28 +15,54 @@ NAMESPACE_BEGIN(CryptoPP)
 // EcPrecomputation<EC2N>;
 // EcPrecomputation<ECP>;
 
+// thrown when loading a precomputation image that is truncated, corrupt, or was saved for
+// another modulus or element representation
+class InvalidPrecomputationImage : public Exception
+{
+public:
+	InvalidPrecomputationImage() : Exception("ExponentiationPrecomputation: invalid precomputation image") {}
+};
+
+// the number of bases per comb table EcPrecomputation<> uses unless told otherwise,
+// with 16 stored points this is two tables of 255 points, for about 2.5 times the speed
+const unsigned int DEFAULT_COMB_TEETH = 8;
+// the most it will take, a table size of 2^teeth-1 must fit in an unsigned int
+const unsigned int MAX_COMB_TEETH = 30;
+
 template <class T> class ExponentiationPrecomputation
 {
 public:
 	typedef T Element;
 	typedef AbstractGroup<T> Group;
 
-	ExponentiationPrecomputation(const Group &group) : group(group) {}
+	ExponentiationPrecomputation(const Group &group) : group(group), combTeeth(0) {}
 
 	ExponentiationPrecomputation(const Group &group, const Element &base, unsigned int maxExpBits, unsigned int storage)
-		: group(group), storage(storage), g(storage) {Precompute(base, maxExpBits);}
+		: group(group), storage(storage), g(storage), combTeeth(0) {Precompute(base, maxExpBits);}
 
 	ExponentiationPrecomputation(const Group &group, const ExponentiationPrecomputation &pc)
-		: group(group), storage(pc.storage), exponentBase(pc.exponentBase), g(pc.g)	{}
+		: group(group), storage(pc.storage), exponentBase(pc.exponentBase), g(pc.g), combTeeth(pc.combTeeth), comb(pc.comb) {}
 
 	void Precompute(const Element &base, unsigned int maxExpBits);
-	Element Exponentiate(const Integer &exponent) const;
-	Element CascadeExponentiate(const Integer &exponent, const ExponentiationPrecomputation<T> &pc2, const Integer &exponent2) const;
+	// builds the tables for the fixed-base comb method (Lim-Lee): for each run of teeth consecutive
+	// bases, the sums of all nonempty subsets of the run, about (storage/teeth)*2^teeth elements in all,
+	// after which Exponentiate() takes exponentBase.BitCount()-1 doublings and storage/teeth additions
+	// per doubling, teeth == 0 frees the tables
+	void PrecomputeComb(unsigned int teeth);
+	// these only read the tables and do their arithmetic in group, which must be a copy of the one
+	// the tables were made in, so threads with groups of their own can share one precomputation
+	Element Exponentiate(const Group &group, const Integer &exponent) const;
+	Element CascadeExponentiate(const Group &group, const Integer &exponent, const ExponentiationPrecomputation<T> &pc2, const Integer &exponent2) const;
+
+	bool CombApplies(const Integer &exponent) const;
+	void AccumulateComb(const Group &group, Element &result, bool &empty, const Integer &exponent, unsigned int column) const;
 
 	const Group &group;
 	unsigned int storage;	// number of precalculated bases
 	Integer exponentBase;	// what base to represent the exponent in
 	std::vector<Element> g;		// precalculated bases
+	unsigned int combTeeth;		// number of bases per comb table, 0 if there are no comb tables
+	std::vector<Element> comb;	// comb tables, the one for bases [q*combTeeth, (q+1)*combTeeth) starts at q*(2^combTeeth-1)
 };
 
 NAMESPACE_END
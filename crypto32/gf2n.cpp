@@ -110,7 +110,7 @@ void PolynomialMod2::Decode(const byte *input, unsigned int inputLen)
 	reg.CleanNew(bytesToWords(inputLen));
 
 	for (unsigned int i=0; i<inputLen; i++)
-		reg[i/WORD_SIZE] |= input[inputLen-1-i] << (i%WORD_SIZE)*8;
+		reg[i/WORD_SIZE] |= word(input[inputLen-1-i]) << (i%WORD_SIZE)*8;
 }
 
 unsigned int PolynomialMod2::Encode(byte *output, unsigned int outputLen) const
@@ -194,16 +194,91 @@ PolynomialMod2 operator&(const PolynomialMod2 &a, const PolynomialMod2 &b)
 	return result;
 }
 
-PolynomialMod2 operator*(const PolynomialMod2 &a, const PolynomialMod2 &b)
+#ifdef X86_64_ASSEMBLY
+static bool HasCarrylessMultiply()
+{
+	word32 a, b, c, d;
+	__asm__ ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1), "c" (0));
+	return (c & 2) != 0;	// PCLMULQDQ
+}
+
+// r[0..2) = the carryless product of a and b
+static inline void CarrylessMultiply(word *r, word a, word b)
 {
-	PolynomialMod2 result((word)0, a.BitCount() + b.BitCount());
+	__asm__
+	(
+		"movq %2, %%xmm0\n\t"
+		"movq %3, %%xmm1\n\t"
+		"pclmulqdq $0, %%xmm1, %%xmm0\n\t"
+		"movq %%xmm0, %0\n\t"
+		"psrldq $8, %%xmm0\n\t"
+		"movq %%xmm0, %1"
+		: "=r" (r[0]), "=r" (r[1])
+		: "r" (a), "r" (b)
+		: "xmm0", "xmm1"
+	);
+}
+#endif
+
+// R[0..aSize+bSize) = A*B, using the left-to-right comb method with 4-bit windows:
+// a table of A*u for each 4-bit u replaces WORD_BITS/4 single-bit shifts and adds
+static void CombMultiply(word *R, const word *A, unsigned int aSize, const word *B, unsigned int bSize)
+{
+	const unsigned int tSize = aSize+1;
+	SecWordBlock T(16*tSize);
+
+	SetWords(T, 0, tSize);
+	CopyWords(T+tSize, A, aSize);
+	T[2*tSize-1] = 0;
+	for (unsigned int u=2; u<16; u+=2)
+	{
+		word *Tu = T+u*tSize;
+		CopyWords(Tu, T+u/2*tSize, tSize);
+		ShiftWordsLeftByBits(Tu, tSize, 1);
+		XorWords(Tu+tSize, Tu, T+tSize, tSize);
+	}
+
+	SetWords(R, 0, aSize+bSize);
+	for (int k=WORD_BITS-4; k>=0; k-=4)
+	{
+		for (unsigned int j=0; j<bSize; j++)
+		{
+			unsigned int u = (unsigned int)(B[j] >> k) & 15;
+			if (u)
+				XorWords(R+j, T+u*tSize, tSize);
+		}
+		if (k)
+			ShiftWordsLeftByBits(R, aSize+bSize, 4);
+	}
+}
 
-	for (int i=b.Degree(); i>=0; i--)
+// R[0..aSize+bSize) = A*B, with the carryless multiply instruction if the CPU has one
+static void MultiplyWords(word *R, const word *A, unsigned int aSize, const word *B, unsigned int bSize)
+{
+#ifdef X86_64_ASSEMBLY
+	static const bool hasCarrylessMultiply = HasCarrylessMultiply();
+	if (hasCarrylessMultiply)
 	{
-		result <<= 1;
-		if (b[i])
-			XorWords(result.reg, a.reg, a.reg.size);
+		SetWords(R, 0, aSize+bSize);
+		word t[2];
+		for (unsigned int i=0; i<aSize; i++)
+			for (unsigned int j=0; j<bSize; j++)
+			{
+				CarrylessMultiply(t, A[i], B[j]);
+				R[i+j] ^= t[0];
+				R[i+j+1] ^= t[1];
+			}
+		return;
 	}
+#endif
+	CombMultiply(R, A, aSize, B, bSize);
+}
+
+PolynomialMod2 operator*(const PolynomialMod2 &a, const PolynomialMod2 &b)
+{
+	unsigned int aSize = a.WordCount(), bSize = b.WordCount();
+	PolynomialMod2 result((word)0, STDMAX(1U, aSize+bSize)*WORD_BITS);
+	MultiplyWords(result.reg, a.reg, aSize, b.reg, bSize);
 	return result;
 }
 
@@ -616,36 +691,25 @@ const GF2NT::Element& GF2NT::MultiplicativeInverse(const Element &a) const
 
 const GF2NT::Element& GF2NT::Multiply(const Element &a, const Element &b) const
 {
-	unsigned int aSize = STDMIN(a.reg.size, result.reg.size);
-	Element r((word)0, m);
-
-	for (int i=m-1; i>=0; i--)
-	{
-		if (r[m-1])
-		{
-			ShiftWordsLeftByBits(r.reg.ptr, r.reg.size, 1);
-			XorWords(r.reg.ptr, m_modulus.reg, r.reg.size);
-		}
-		else
-			ShiftWordsLeftByBits(r.reg.ptr, r.reg.size, 1);
-
-		if (b[i])
-			XorWords(r.reg.ptr, a.reg, aSize);
-	}
+	unsigned int aSize = STDMIN(a.WordCount(), result.reg.size);
+	unsigned int bSize = STDMIN(b.WordCount(), result.reg.size);
+	SecWordBlock t(2*result.reg.size);
 
-	if (m%WORD_BITS)
-		r.reg.ptr[r.reg.size-1] = (word)Crop(r.reg[r.reg.size-1], m%WORD_BITS);
-
-	CopyWords(result.reg.ptr, r.reg.ptr, result.reg.size);
-	return result;
+	MultiplyWords(t, a.reg, aSize, b.reg, bSize);
+	SetWords(t+aSize+bSize, 0, t.size-aSize-bSize);
+	return ReducedWords(t, t.size);
 }
 
 const GF2NT::Element& GF2NT::Reduced(const Element &a) const
 {
 	SecWordBlock b(a.reg);
+	return ReducedWords(b, b.size);
+}
 
+const GF2NT::Element& GF2NT::ReducedWords(word *b, unsigned int bSize) const
+{
 	unsigned i;
-	for (i=b.size-1; i>=bitsToWords(t0); i--)
+	for (i=bSize-1; i>=bitsToWords(t0); i--)
 	{
 		word temp = b[i];
 
@@ -677,17 +741,16 @@ const GF2NT::Element& GF2NT::Reduced(const Element &a) const
 		if ((t0-t1)%WORD_BITS)
 		{
 			b[i-(t0-t1)/WORD_BITS] ^= temp >> (t0-t1)%WORD_BITS;
+			// otherwise nothing spills into the word below, since temp has no bits under t0%WORD_BITS
 			if ((t0-t1)%WORD_BITS > t0%WORD_BITS)
 				b[i-(t0-t1)/WORD_BITS-1] ^= temp << (WORD_BITS - (t0-t1)%WORD_BITS);
-			else
-				assert(temp==0);
 		}
 		else
 			b[i-(t0-t1)/WORD_BITS] ^= temp;
 	}
 
 	SetWords(result.reg.ptr, 0, result.reg.size);
-	CopyWords(result.reg.ptr, b, STDMIN(b.size, result.reg.size));
+	CopyWords(result.reg.ptr, b, STDMIN(bSize, result.reg.size));
 	return result;
 }
 
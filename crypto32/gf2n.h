@@ -278,6 +278,8 @@ public:
 
 private:
 	const Element& Reduced(const Element &a) const;
+	// reduces b[0..bSize) in place and copies the result into result
+	const Element& ReducedWords(word *b, unsigned int bSize) const;
 
 	unsigned int t0, t1;
 	PolynomialMod2 result;
@@ -8,6 +8,7 @@
 #include "words.h"
 
 #include <iostream>
+#include <vector>
 
 #include "algebra.cpp"
 #include "eprecomp.cpp"
@@ -16,6 +17,22 @@ NAMESPACE_BEGIN(CryptoPP)
 
 #define MAKE_DWORD(lowWord, highWord) ((dword(highWord)<<WORD_BITS) | (lowWord))
 
+// divide {highWord, lowWord} by divisor, highWord must be less than divisor
+static inline word DivideDword(word &remainder, word lowWord, word highWord, word divisor)
+{
+	assert(highWord < divisor);
+#ifdef X86_64_ASSEMBLY
+	// a single divq, rather than a call to the generic 128-bit division routine
+	word quotient;
+	__asm__ ("divq %4" : "=a" (quotient), "=d" (remainder) : "a" (lowWord), "d" (highWord), "rm" (divisor) : "cc");
+	return quotient;
+#else
+	dword dividend = MAKE_DWORD(lowWord, highWord);
+	remainder = word(dividend % divisor);
+	return word(dividend / divisor);
+#endif
+}
+
 // CodeWarrior defines _MSC_VER
 #if defined(_MSC_VER) && !defined(__MWERKS__) && defined(_M_IX86) && (_M_IX86<=500)
 
@@ -120,6 +137,71 @@ loopend:
 	}
 }
 
+#elif defined(X86_64_ASSEMBLY)
+
+// with 64-bit words the carry chain is the bottleneck, so keep it in the
+// carry flag instead of recomputing it from the high half of a dword
+
+static word Add(word *C, const word *A, const word *B, unsigned int N)
+{
+	assert (N%2 == 0);
+
+	if (N == 0)
+		return 0;
+
+	word carry, t0, t1, i = 0, n = N/2;
+	__asm__ __volatile__
+	(
+		"clc\n"
+	"1:\n\t"
+		"movq	(%[a],%[i],8), %[t0]\n\t"
+		"movq	8(%[a],%[i],8), %[t1]\n\t"
+		"adcq	(%[b],%[i],8), %[t0]\n\t"
+		"adcq	8(%[b],%[i],8), %[t1]\n\t"
+		"movq	%[t0], (%[c],%[i],8)\n\t"
+		"movq	%[t1], 8(%[c],%[i],8)\n\t"
+		"leaq	2(%[i]), %[i]\n\t"
+		"decq	%[n]\n\t"
+		"jnz	1b\n\t"
+		"sbbq	%[carry], %[carry]\n\t"
+		"negq	%[carry]"
+		: [carry] "=&r" (carry), [t0] "=&r" (t0), [t1] "=&r" (t1), [i] "+r" (i), [n] "+r" (n)
+		: [a] "r" (A), [b] "r" (B), [c] "r" (C)
+		: "cc", "memory"
+	);
+	return carry;
+}
+
+static word Subtract(word *C, const word *A, const word *B, unsigned int N)
+{
+	assert (N%2 == 0);
+
+	if (N == 0)
+		return 0;
+
+	word borrow, t0, t1, i = 0, n = N/2;
+	__asm__ __volatile__
+	(
+		"clc\n"
+	"1:\n\t"
+		"movq	(%[a],%[i],8), %[t0]\n\t"
+		"movq	8(%[a],%[i],8), %[t1]\n\t"
+		"sbbq	(%[b],%[i],8), %[t0]\n\t"
+		"sbbq	8(%[b],%[i],8), %[t1]\n\t"
+		"movq	%[t0], (%[c],%[i],8)\n\t"
+		"movq	%[t1], 8(%[c],%[i],8)\n\t"
+		"leaq	2(%[i]), %[i]\n\t"
+		"decq	%[n]\n\t"
+		"jnz	1b\n\t"
+		"sbbq	%[borrow], %[borrow]\n\t"
+		"negq	%[borrow]"
+		: [borrow] "=&r" (borrow), [t0] "=&r" (t0), [t1] "=&r" (t1), [i] "+r" (i), [n] "+r" (n)
+		: [a] "r" (A), [b] "r" (B), [c] "r" (C)
+		: "cc", "memory"
+	);
+	return borrow;
+}
+
 #else	// defined(_MSC_VER) && !defined(__MWERKS__) && defined(_M_IX86) && (_M_IX86<=500)
 
 static word Add(word *C, const word *A, const word *B, unsigned int N)
@@ -394,6 +476,15 @@ static void AtomicInverseModPower2(word *C, word A0, word A1)
 
 // ********************************************************
 
+// above these sizes (in words) RecursiveMultiply() and RecursiveSquare()
+// switch from Karatsuba to Toom-Cook and then to NTT multiplication
+static const unsigned int TOOM3_THRESHOLD = 1024;
+static const unsigned int NTT_THRESHOLD = 8192;
+
+static void LargeMultiply(word *R, const word *A, const word *B, unsigned int N);
+
+// ********************************************************
+
 #define A0		A
 #define A1		(A+N2)
 #define B0		B
@@ -422,6 +513,8 @@ void RecursiveMultiply(word *R, word *T, const word *A, const word *B, unsigned
 		AtomicMultiply(R, A[0], A[1], B[0], B[1]);
 	else if (N==4)
 		CombaMultiply(R, A, B);
+	else if (N>=TOOM3_THRESHOLD)
+		LargeMultiply(R, A, B, N);
 	else
 	{
 		const unsigned int N2 = N/2;
@@ -489,6 +582,8 @@ void RecursiveSquare(word *R, word *T, const word *A, unsigned int N)
 		AtomicSquare(R, A[0], A[1]);
 	else if (N==4)
 		CombaMultiply(R, A, A);
+	else if (N>=TOOM3_THRESHOLD)
+		LargeMultiply(R, A, A, N);
 	else
 	{
 		const unsigned int N2 = N/2;
@@ -776,6 +871,436 @@ void HalfMontgomeryReduce(word *R, word *T, const word *X, const word *M, const
 #undef R2
 #undef R3
 
+// ********************************************************
+
+// R[2*N] - result = A*B
+// A[N] --- multiplier
+// B[N] --- multiplicant
+
+static void SchoolbookMultiply(word *R, const word *A, const word *B, unsigned int N)
+{
+	R[N] = LinearMultiply(R, A, B[0], N);
+	for (unsigned int i=1; i<N; i++)
+	{
+		word carry = 0;
+		for (unsigned int j=0; j<N; j++)
+		{
+			dword p = (dword)A[j] * B[i] + R[i+j] + carry;
+			R[i+j] = LOW_WORD(p);
+			carry = HIGH_WORD(p);
+		}
+		R[i+N] = carry;
+	}
+}
+
+// D[NX] - result = |X-Y|, returns true if X<Y
+// X[NX]
+// Y[NY] - NY<=NX
+
+static bool AbsoluteDifference(word *D, const word *X, unsigned int NX, const word *Y, unsigned int NY)
+{
+	unsigned int i = NY;
+	while (i<NX && !X[i])
+		i++;
+
+	if (i<NX || Compare(X, Y, NY) >= 0)
+	{
+		word borrow = Subtract(D, X, Y, NY);
+		CopyWords(D+NY, X+NY, NX-NY);
+		if (NX>NY)
+			Decrement(D+NY, NX-NY, borrow);
+		return false;
+	}
+	else
+	{
+		Subtract(D, Y, X, NY);
+		SetWords(D+NY, 0, NX-NY);
+		return true;
+	}
+}
+
+// X[NX] - X += Y, carry out of X is discarded
+// Y[NY] - NY<=NX
+
+static void AddInto(word *X, unsigned int NX, const word *Y, unsigned int NY)
+{
+	word carry = Add(X, X, Y, NY);
+	if (NX>NY)
+		Increment(X+NY, NX-NY, carry);
+}
+
+// X[NX] - X -= Y, borrow out of X is discarded
+// Y[NY] - NY<=NX
+
+static void SubtractFrom(word *X, unsigned int NX, const word *Y, unsigned int NY)
+{
+	word borrow = Subtract(X, X, Y, NY);
+	if (NX>NY)
+		Decrement(X+NY, NX-NY, borrow);
+}
+
+// R[2*N] ----- result = A*B, N need only be even
+// T[8*N+32] -- temporary work space
+// A[N] ------- multiplier
+// B[N] ------- multiplicant
+
+static void GeneralMultiply(word *R, word *T, const word *A, const word *B, unsigned int N)
+{
+	assert(N && N%2==0);
+
+	if ((N & (N-1)) == 0)
+	{
+		if (A == B)
+			RecursiveSquare(R, T, A, N);
+		else
+			RecursiveMultiply(R, T, A, B, N);
+	}
+	else if (N >= TOOM3_THRESHOLD)
+		LargeMultiply(R, A, B, N);
+	else if (N < 16)
+		SchoolbookMultiply(R, A, B, N);
+	else
+	{
+		// Karatsuba, with the high halves possibly shorter than the low halves
+		const unsigned int H = (N/2+1) & ~1U;
+		const unsigned int L = N-H;
+		word *const DA = T;
+		word *const DB = T+H;
+		word *const P = T+2*H;
+		word *const M = T+4*H;
+
+		bool aNegative = AbsoluteDifference(DA, A, H, A+H, L);
+		bool bNegative = (A == B) ? aNegative : AbsoluteDifference(DB, B, H, B+H, L);
+
+		GeneralMultiply(P, M, DA, (A == B) ? DA : DB, H);
+		GeneralMultiply(R, M, A, B, H);
+		GeneralMultiply(R+2*H, M, A+H, B+H, L);
+
+		// M = A0*B0 + A1*B1 - (A0-A1)*(B0-B1)
+		CopyWords(M, R, 2*H);
+		M[2*H] = M[2*H+1] = 0;
+		AddInto(M, 2*H+2, R+2*H, 2*L);
+		if (aNegative == bNegative)
+			SubtractFrom(M, 2*H+2, P, 2*H);
+		else
+			AddInto(M, 2*H+2, P, 2*H);
+
+		AddInto(R+H, 2*N-H, M, 2*H+2);
+	}
+}
+
+// R[2*N] - result = A*B, Toom-Cook 3 way multiplication using
+//			evaluation points 0, 1, -1, 2 and infinity
+// A[N] --- multiplier
+// B[N] --- multiplicant
+
+static void Toom3Multiply(word *R, const word *A, const word *B, unsigned int N)
+{
+	assert(N%2==0 && N>=32);
+
+	const bool square = (A == B);
+	const unsigned int K = ((N+2)/3 + 1) & ~1U;		// size of the low and middle parts
+	const unsigned int K2 = N-2*K;					// size of the high part
+	const unsigned int M = K+2;						// size of the evaluations
+	const unsigned int L = 2*M;						// size of their products
+	unsigned int i, j;
+
+	SecWordBlock buffer(6*M + 5*L + 8*M+32);
+	word *const E = buffer;				// evaluations at 1, -1, 2 of A then B
+	word *const V1 = E+6*M;
+	word *const Vm1 = V1+L;
+	word *const V2 = Vm1+L;
+	word *const X = V2+L;
+	word *const Y = X+L;
+	word *const T = Y+L;
+
+	bool negative[2] = {false, false};
+	for (i=0; i<(square ? 1U : 2U); i++)
+	{
+		const word *const X0 = i ? B : A;
+		word *const E1 = E+3*i*M, *const Em1 = E1+M, *const E2 = Em1+M;
+
+		// E1 = X0+X2, then Em1 = X0-X1+X2 and E1 = X0+X1+X2
+		CopyWords(E1, X0, K);
+		E1[K] = E1[K+1] = 0;
+		AddInto(E1, M, X0+2*K, K2);
+		negative[i] = AbsoluteDifference(Em1, E1, M, X0+K, K);
+		AddInto(E1, M, X0+K, K);
+
+		// E2 = X0+2*X1+4*X2
+		CopyWords(E2, X0+2*K, K2);
+		SetWords(E2+K2, 0, M-K2);
+		ShiftWordsLeftByBits(E2, M, 1);
+		AddInto(E2, M, X0+K, K);
+		ShiftWordsLeftByBits(E2, M, 1);
+		AddInto(E2, M, X0, K);
+	}
+
+	const word *const F = square ? E : E+3*M;
+	GeneralMultiply(V1, T, E, F, M);
+	GeneralMultiply(Vm1, T, E+M, F+M, M);
+	GeneralMultiply(V2, T, E+2*M, F+2*M, M);
+	const bool vm1Negative = square ? false : (negative[0] != negative[1]);
+
+	// the products at 0 and infinity go straight into place
+	GeneralMultiply(R, T, A, B, K);
+	SetWords(R+2*K, 0, 2*K);
+	GeneralMultiply(R+4*K, T, A+2*K, B+2*K, K2);
+	const word *const V0 = R;
+	const word *const Vinf = R+4*K;
+
+	// all quantities below are non-negative and fit in L words, so they
+	// can be calculated modulo 2**(WORD_BITS*L)
+
+	// V1 = coefficient 2 = (V1+Vm1)/2 - V0 - Vinf
+	// Vm1 = coefficients 1+3 = (V1-Vm1)/2
+	CopyWords(X, V1, L);
+	if (vm1Negative)
+	{
+		Subtract(V1, V1, Vm1, L);
+		Add(Vm1, X, Vm1, L);
+	}
+	else
+	{
+		Add(V1, V1, Vm1, L);
+		Subtract(Vm1, X, Vm1, L);
+	}
+	ShiftWordsRightByBits(V1, L, 1);
+	ShiftWordsRightByBits(Vm1, L, 1);
+	SubtractFrom(V1, L, V0, 2*K);
+	SubtractFrom(V1, L, Vinf, 2*K2);
+
+	// V2 = coefficient 3 = ((V2-V0-4*coefficient 2-16*Vinf)/2 - coefficients 1+3)/3
+	SubtractFrom(V2, L, V0, 2*K);
+	CopyWords(X, V1, L);
+	ShiftWordsLeftByBits(X, L, 2);
+	Subtract(V2, V2, X, L);
+	CopyWords(X, Vinf, 2*K2);
+	SetWords(X+2*K2, 0, L-2*K2);
+	ShiftWordsLeftByBits(X, L, 4);
+	Subtract(V2, V2, X, L);
+	ShiftWordsRightByBits(V2, L, 1);
+	Subtract(V2, V2, Vm1, L);
+	word remainder = 0;
+	for (j=L; j--; )
+		V2[j] = DivideDword(remainder, V2[j], remainder, 3);
+	assert(remainder == 0);
+
+	// Vm1 = coefficient 1
+	Subtract(Vm1, Vm1, V2, L);
+
+	// add the middle coefficients into place
+	for (i=1; i<=3; i++)
+	{
+		const word *const C = (i==1) ? Vm1 : (i==2 ? V1 : V2);
+		const unsigned int offset = i*K;
+		const unsigned int n = STDMIN(L, 2*N-offset);
+		for (j=n; j<L; j++)
+			assert(C[j] == 0);
+		AddInto(R+offset, 2*N-offset, C, n);
+	}
+}
+
+// multiplication by number theoretic transforms modulo three primes of
+// the form c*2**k+1 that fit in a word, recombined by the Chinese remainder theorem
+
+#ifdef WORD128_AVAILABLE
+static const word NTTPrimes[3] = {W64LIT(0x3a00000000000001), W64LIT(0x3ea0000000000001), W64LIT(0x3fdc000000000001)};
+static const word NTTGenerators[3] = {3, 7, 3};
+static const unsigned int NTT_MAX_LOG_SIZE = 50;
+#else
+static const word NTTPrimes[3] = {469762049, 167772161, 754974721};
+static const word NTTGenerators[3] = {3, 3, 11};
+// also keeps the convolution below the product of the primes
+static const unsigned int NTT_MAX_LOG_SIZE = 21;
+#endif
+
+// arithmetic modulo one of the NTT primes, multiplication is in Montgomery form
+struct NTTModulus
+{
+	NTTModulus(word p) : p(p)
+	{
+		word x = p;
+		for (unsigned int i=0; i<6; i++)
+			x *= 2-p*x;
+		pinv = 0-x;
+		one = word((dword(1)<<WORD_BITS) % p);
+		r2 = word((dword)one*one % p);
+	}
+
+	// a*b/2**WORD_BITS mod p
+	word MultiplyMod(word a, word b) const
+	{
+		dword t = (dword)a*b;
+		word m = LOW_WORD(t)*pinv;
+		word u = HIGH_WORD(t) + HIGH_WORD((dword)m*p) + (LOW_WORD(t)!=0);
+		return u>=p ? u-p : u;
+	}
+	word AddMod(word a, word b) const
+		{word s = a+b; return s>=p ? s-p : s;}
+	word SubtractMod(word a, word b) const
+		{return a>=b ? a-b : a-b+p;}
+	// any word, not just a residue, can be converted
+	word ConvertIn(word a) const
+		{return MultiplyMod(a, r2);}
+	word Reduce(word a) const
+		{return MultiplyMod(ConvertIn(a), 1);}
+	word Exponentiate(word a, word e) const
+	{
+		word r = one;
+		for (; e; e>>=1, a=MultiplyMod(a, a))
+			if (e&1)
+				r = MultiplyMod(r, a);
+		return r;
+	}
+
+	word p, pinv, one, r2;
+};
+
+// A[N] - in natural order, result in bit reversed order
+// W[N/2] - powers of a primitive N-th root of unity, in Montgomery form
+
+static void NTTForward(word *A, const word *W, unsigned int N, const NTTModulus &m)
+{
+	for (unsigned int len=N, stride=1; len>=2; len/=2, stride*=2)
+	{
+		const unsigned int half = len/2;
+		for (unsigned int s=0; s<N; s+=len)
+			for (unsigned int j=0; j<half; j++)
+			{
+				word u = A[s+j], v = A[s+j+half];
+				A[s+j] = m.AddMod(u, v);
+				A[s+j+half] = m.MultiplyMod(m.SubtractMod(u, v), W[j*stride]);
+			}
+	}
+}
+
+// A[N] - in bit reversed order, result in natural order times N
+// W[N/2] - powers of the inverse root of unity, in Montgomery form
+
+static void NTTInverse(word *A, const word *W, unsigned int N, const NTTModulus &m)
+{
+	for (unsigned int len=2, stride=N/2; len<=N; len*=2, stride/=2)
+	{
+		const unsigned int half = len/2;
+		for (unsigned int s=0; s<N; s+=len)
+			for (unsigned int j=0; j<half; j++)
+			{
+				word u = A[s+j], v = m.MultiplyMod(A[s+j+half], W[j*stride]);
+				A[s+j] = m.AddMod(u, v);
+				A[s+j+half] = m.SubtractMod(u, v);
+			}
+	}
+}
+
+static unsigned int NTTSize(unsigned int NA, unsigned int NB)
+{
+	unsigned int n = 2;
+	while (n < NA+NB)
+		n *= 2;
+	return n;
+}
+
+// R[NA+NB] - result = A*B
+// A[NA] ---- multiplier
+// B[NB] ---- multiplicant
+
+static void NTTMultiply(word *R, const word *A, unsigned int NA, const word *B, unsigned int NB)
+{
+	const bool square = (A == B && NA == NB);
+	const unsigned int n = NTTSize(NA, NB);
+	assert(BitPrecision(n)-1 <= NTT_MAX_LOG_SIZE);
+
+	SecWordBlock residues(3*n), b(n), w(n/2), iw(n/2);
+	unsigned int i, j;
+
+	for (i=0; i<3; i++)
+	{
+		const NTTModulus m(NTTPrimes[i]);
+		const word root = m.Exponentiate(m.ConvertIn(NTTGenerators[i]), (m.p-1)/n);
+		const word iroot = m.Exponentiate(root, n-1);
+		w[0] = iw[0] = m.one;
+		for (j=1; j<n/2; j++)
+		{
+			w[j] = m.MultiplyMod(w[j-1], root);
+			iw[j] = m.MultiplyMod(iw[j-1], iroot);
+		}
+
+		// transform the inputs in Montgomery form, so the pointwise
+		// products come out in Montgomery form too
+		word *const a = residues+i*n;
+		for (j=0; j<NA; j++)
+			a[j] = m.ConvertIn(A[j]);
+		SetWords(a+NA, 0, n-NA);
+		NTTForward(a, w, n, m);
+
+		if (square)
+			for (j=0; j<n; j++)
+				a[j] = m.MultiplyMod(a[j], a[j]);
+		else
+		{
+			for (j=0; j<NB; j++)
+				b[j] = m.ConvertIn(B[j]);
+			SetWords(b+NB, 0, n-NB);
+			NTTForward(b, w, n, m);
+			for (j=0; j<n; j++)
+				a[j] = m.MultiplyMod(a[j], b[j]);
+		}
+
+		NTTInverse(a, iw, n, m);
+
+		// divide by n and convert out of Montgomery form
+		const word scale = m.p - (m.p-1)/n;
+		for (j=0; j<n; j++)
+			a[j] = m.MultiplyMod(a[j], scale);
+	}
+
+	// Garner's algorithm: x = y1 + p1*y2 + p1*p2*y3
+	const NTTModulus m2(NTTPrimes[1]), m3(NTTPrimes[2]);
+	const word p1 = NTTPrimes[0], p2 = NTTPrimes[1];
+	const word p1InverseMod2 = m2.Exponentiate(m2.ConvertIn(p1), p2-2);
+	const word p1Mod3 = m3.ConvertIn(p1);
+	const word p12InverseMod3 = m3.Exponentiate(m3.MultiplyMod(p1Mod3, m3.ConvertIn(p2)), m3.p-2);
+	const dword p12 = (dword)p1*p2;
+	const word p12Low = LOW_WORD(p12), p12High = HIGH_WORD(p12);
+
+	word c0=0, c1=0, c2=0;
+	for (j=0; j<NA+NB; j++)
+	{
+		const word y1 = residues[j];
+		const word y2 = m2.MultiplyMod(m2.SubtractMod(residues[n+j], m2.Reduce(y1)), p1InverseMod2);
+		const word t = m3.AddMod(m3.Reduce(y1), m3.MultiplyMod(m3.Reduce(y2), p1Mod3));
+		const word y3 = m3.MultiplyMod(m3.SubtractMod(residues[2*n+j], t), p12InverseMod3);
+
+		dword u = (dword)p1*y2 + y1;
+		word x0 = LOW_WORD(u), x1 = HIGH_WORD(u);
+		u = (dword)p12Low*y3 + x0;
+		x0 = LOW_WORD(u);
+		u = (dword)p12High*y3 + x1 + HIGH_WORD(u);
+		x1 = LOW_WORD(u);
+		word x2 = HIGH_WORD(u);
+
+		u = (dword)c0 + x0;
+		R[j] = LOW_WORD(u);
+		u = (dword)c1 + x1 + HIGH_WORD(u);
+		c0 = LOW_WORD(u);
+		u = (dword)c2 + x2 + HIGH_WORD(u);
+		c1 = LOW_WORD(u);
+		c2 = HIGH_WORD(u);
+	}
+	assert(c0==0 && c1==0 && c2==0);
+}
+
+// R[2*N] - result = A*B, for N >= TOOM3_THRESHOLD
+
+static void LargeMultiply(word *R, const word *A, const word *B, unsigned int N)
+{
+	if (N >= NTT_THRESHOLD && BitPrecision(NTTSize(N, N))-1 <= NTT_MAX_LOG_SIZE)
+		NTTMultiply(R, A, N, B, N);
+	else
+		Toom3Multiply(R, A, B, N);
+}
+
 // do a 3 word by 2 word divide, returns quotient and leaves remainder in A
 static word SubatomicDivide(word *A, word B0, word B1)
 {
@@ -789,7 +1314,10 @@ static word SubatomicDivide(word *A, word B0, word B1)
 	if (B1+1 == 0)
 		Q = A[2];
 	else
-		Q = word(MAKE_DWORD(A[1], A[2]) / (B1+1));
+	{
+		word r;
+		Q = DivideDword(r, A[1], A[2], B1+1);
+	}
 
 	// now subtract Q*B from A
 	p = (dword) B0*Q;
@@ -1251,6 +1779,93 @@ Integer::Integer(word value, unsigned int length)
 }
 
 
+// Decimal conversion splits numbers at the powers chunkBase^(2^i) of the largest power of 10 that
+// fits in a word with its top bit clear, so that most of the work is done by multiplications and divisions of balanced size.
+// Numbers of up to this many chunks are converted one chunk at a time.
+static const unsigned int decimalLeafChunks = 16;
+
+static word DecimalChunkBase(unsigned int &chunkDigits)
+{
+	word chunkBase = 10;
+	chunkDigits = 1;
+	while (chunkBase <= (~word(0)>>1)/10)
+	{
+		chunkBase *= 10;
+		chunkDigits++;
+	}
+	return chunkBase;
+}
+
+// extends powers, which starts out holding chunkBase, so that powers[i] = chunkBase^(2^i) for i <= level
+static void DecimalPowers(std::vector<Integer> &powers, unsigned int level)
+{
+	while (powers.size() <= level)
+		powers.push_back(powers.back().Squared());
+}
+
+// returns the value of the decimal digits[0..count), most significant first
+static Integer ReadDecimal(const byte *digits, unsigned int count, std::vector<Integer> &powers, unsigned int chunkDigits)
+{
+	if (count <= chunkDigits*decimalLeafChunks)
+	{
+		Integer result;
+		unsigned int i = 0, length = count%chunkDigits ? count%chunkDigits : chunkDigits;
+		while (i < count)
+		{
+			word chunk = 0, scale = 1;
+			for (unsigned int j=0; j<length; j++)
+			{
+				chunk = chunk*10 + digits[i+j];
+				scale *= 10;
+			}
+			result *= scale;
+			result += chunk;
+			i += length;
+			length = chunkDigits;
+		}
+		return result;
+	}
+
+	unsigned int level = 0;
+	while ((chunkDigits << (level+1)) < count)
+		level++;
+	DecimalPowers(powers, level);
+
+	const unsigned int lowCount = chunkDigits << level;
+	return ReadDecimal(digits, count-lowCount, powers, chunkDigits) * powers[level]
+		+ ReadDecimal(digits+count-lowCount, lowCount, powers, chunkDigits);
+}
+
+// writes x, which must be less than chunkBase^chunks, as exactly chunks*chunkDigits decimal digits
+// ending just before end, chunks must be a power of 2
+static void WriteDecimal(char *end, const Integer &x, unsigned int chunks, std::vector<Integer> &powers, word chunkBase, unsigned int chunkDigits)
+{
+	if (chunks <= decimalLeafChunks)
+	{
+		Integer q, r = x;
+		for (unsigned int i=0; i<chunks; i++)
+		{
+			word chunk = Integer::ShortDivide(q, r, chunkBase);
+			r = q;
+			for (unsigned int j=0; j<chunkDigits; j++)
+			{
+				*--end = char('0' + chunk%10);
+				chunk /= 10;
+			}
+		}
+		return;
+	}
+
+	const unsigned int half = chunks/2;
+	const unsigned int level = BitPrecision(half)-1;
+	DecimalPowers(powers, level);
+
+	Integer q, r;
+	Integer::Divide(r, q, x, powers[level]);
+	WriteDecimal(end, r, half, powers, chunkBase, chunkDigits);
+	WriteDecimal(end-half*chunkDigits, q, half, powers, chunkBase, chunkDigits);
+}
+
 Integer::Integer(const char *str)
 	: reg(2), sign(POSITIVE)
 {
@@ -1283,6 +1898,9 @@ Integer::Integer(const char *str)
 	if (strncmp("0x", str, 2) == 0)
 		radix = 16;
 
+	SecByteBlock digits(length);
+	unsigned int digitCount = 0;
+
 	for (unsigned i=0; i<length; i++)
 	{
 		word digit;
@@ -1297,10 +1915,31 @@ Integer::Integer(const char *str)
 			digit = radix;
 
 		if (digit < radix)
+			digits[digitCount++] = (byte)digit;
+	}
+
+	if (radix == 10)
+	{
+		unsigned int chunkDigits;
+		std::vector<Integer> powers(1, Integer(DecimalChunkBase(chunkDigits)));
+		*this = ReadDecimal(digits, digitCount, powers, chunkDigits);
+	}
+	else
+	{
+		// the other radixes are powers of 2, so each digit can be put in place directly
+		const unsigned int digitBits = BitPrecision(radix)-1;
+		reg.CleanNew(RoundupSize(bitsToWords(digitCount*digitBits)));
+		for (unsigned int i=0; i<digitCount; i++)
 		{
-			*this *= radix;
-			*this += digit;
+			const unsigned int position = (digitCount-1-i)*digitBits;
+			const word digit = digits[i];
+			reg[position/WORD_BITS] |= digit << (position%WORD_BITS);
+			if (position%WORD_BITS + digitBits > WORD_BITS)
+				reg[position/WORD_BITS+1] |= digit >> (WORD_BITS - position%WORD_BITS);
 		}
+		// leading zero digits, such as the one of "0x", mustn't make reg longer than usual,
+		// since MontgomeryRepresentation and others size their work by modulus.reg.size
+		reg.Resize(RoundupSize(WordCount()));
 	}
 
 	if (str[0] == '-')
@@ -1343,12 +1982,12 @@ void Integer::Decode(const byte *input, unsigned int inputLen, Signedness s)
 	reg.CleanNew(RoundupSize(bytesToWords(inputLen)));
 
 	for (unsigned i=0; i<inputLen; i++)
-		reg[i/WORD_SIZE] |= input[inputLen-1-i] << (i%WORD_SIZE)*8;
+		reg[i/WORD_SIZE] |= word(input[inputLen-1-i]) << (i%WORD_SIZE)*8;
 
 	if (sign == NEGATIVE)
 	{
 		for (unsigned i=inputLen; i<reg.size*WORD_SIZE; i++)
-			reg[i/WORD_SIZE] |= 0xff << (i%WORD_SIZE)*8;
+			reg[i/WORD_SIZE] |= word(0xff) << (i%WORD_SIZE)*8;
 		TwosComplement(reg, reg.size);
 	}
 }
@@ -1506,8 +2145,7 @@ bool Integer::Randomize(RandomNumberGenerator &rng, const Integer &min, const In
 						return false;
 				}
 
-				Randomize(rng, min, max);
-				if (FirstPrime(*this, STDMIN(*this+mod*PrimeSearchInterval(max), max), equiv, mod))
+				if (RandomPrimeSearch(*this, rng, min, max, equiv, mod))
 					return true;
 			}
 
@@ -1566,32 +2204,46 @@ std::ostream& operator<<(std::ostream& out, const Integer &a)
 		suffix = '.';
 	}
 
-	SecBlock<char> s(a.BitCount() / (BitPrecision(base)-1) + 1);
-	Integer temp1=a, temp2;
-	unsigned i=0;
-	const char vec[]="0123456789ABCDEF";
-
 	if (a.IsNegative())
-	{
 		out << '-';
-		temp1.Negate();
-	}
 
 	if (!a)
 		out << '0';
-
-	while (!!temp1)
+	else if (base == 10)
 	{
-		s[i++]=vec[Integer::ShortDivide(temp2, temp1, base)];
-		temp1=temp2;
-	}
+		unsigned int chunkDigits;
+		const word chunkBase = DecimalChunkBase(chunkDigits);
+		std::vector<Integer> powers(1, Integer(chunkBase));
 
-	while (i--)
+		// chunkBase^chunks > |a| since chunkBase >= 2^(BitPrecision(chunkBase)-1)
+		const unsigned int chunkBits = BitPrecision(chunkBase)-1;
+		const unsigned int chunks = 1U << BitPrecision((a.BitCount()+chunkBits-1)/chunkBits - 1);
+		SecBlock<char> s(chunks*chunkDigits + 1);
+		WriteDecimal(s+chunks*chunkDigits, a.AbsoluteValue(), chunks, powers, chunkBase, chunkDigits);
+		s[chunks*chunkDigits] = '\0';
+
+		const char *digits = s;
+		while (*digits == '0')
+			digits++;
+		out << digits;
+	}
+	else
 	{
-		out << s[i];
-//		if (i && !(i%block))
-//			out << ",";
+		// the other bases are powers of 2, so each digit is a fixed group of bits
+		const char vec[]="0123456789ABCDEF";
+		const unsigned int digitBits = BitPrecision(base)-1;
+		unsigned int i = (a.BitCount()+digitBits-1)/digitBits;
+		while (i--)
+		{
+			unsigned int digit = 0;
+			for (unsigned int j=digitBits; j--; )
+				digit = (digit << 1) | a.GetBit(i*digitBits+j);
+			out << vec[digit];
+//			if (i && !(i%block))
+//				out << ",";
+		}
 	}
+
 	return out << suffix;
 }
 
@@ -1823,7 +2475,7 @@ void PositiveMultiply(Integer &product, const Integer &a, const Integer &b)
 	product.reg.CleanNew(RoundupSize(aSize+bSize));
 	product.sign = Integer::POSITIVE;
 
-	SecWordBlock workspace(aSize + bSize);
+	SecBlock<word, SecBlockInlineAllocator<word, 64> > workspace(aSize + bSize);
 	AsymmetricMultiply(product.reg, workspace, a.reg, aSize, b.reg, bSize);
 }
 
@@ -1864,6 +2516,76 @@ void PositiveDivide(Integer &remainder, Integer &quotient,
 }
 */
 
+// above this divisor size (in words) PositiveDivide() multiplies by a
+// reciprocal calculated with Newton's method instead of dividing word by word
+static const unsigned int NEWTON_DIVIDE_THRESHOLD = 1024;
+
+// r = floor(2**(2*n)/b), where b is positive and has exactly n bits
+
+static void NewtonReciprocal(Integer &r, const Integer &b, unsigned int n)
+{
+	// the reciprocal itself pays off at smaller sizes than a full division
+	if (n <= NEWTON_DIVIDE_THRESHOLD/8*WORD_BITS)
+	{
+		r = Integer::Power2(2*n) / b;
+		return;
+	}
+
+	// start from the reciprocal of the top half of b, then one Newton step
+	// x += x*(2**(2*n) - b*x) / 2**(2*n) doubles its precision
+	const unsigned int h = n/2+2;
+	Integer x;
+	NewtonReciprocal(x, b >> (n-h), h);
+	x <<= n-h;
+
+	const Integer p = Integer::Power2(2*n);
+	Integer e = p - b*x;
+	x += (x*e) >> (2*n);
+
+	e = p - b*x;
+	while (e.IsNegative())
+	{
+		--x;
+		e += b;
+	}
+	while (e >= b)
+	{
+		++x;
+		e -= b;
+	}
+	r.swap(x);
+}
+
+// a and b positive, reduces the top 2*b.BitCount() bits of a at a time
+
+static void NewtonDivide(Integer &remainder, Integer &quotient, const Integer &a, const Integer &b)
+{
+	const unsigned int n = b.BitCount();
+	Integer r, x = a, q, t;
+	NewtonReciprocal(r, b, n);
+
+	quotient = Integer::Zero();
+	while (x >= b)
+	{
+		const unsigned int xBits = x.BitCount();
+		const unsigned int shift = xBits > 2*n ? xBits-2*n : 0;
+		const Integer top = x >> shift;
+
+		// r underestimates 2**(2*n)/b, so q is at most 2 too small
+		q = (top*r) >> (2*n);
+		t = top - q*b;
+		while (t >= b)
+		{
+			t -= b;
+			++q;
+		}
+
+		quotient += q << shift;
+		x = (t << shift) + (x - (top << shift));
+	}
+	remainder.swap(x);
+}
+
 void PositiveDivide(Integer &remainder, Integer &quotient,
 				   const Integer &a, const Integer &b)
 {
@@ -1881,6 +2603,12 @@ void PositiveDivide(Integer &remainder, Integer &quotient,
 		return;
 	}
 
+	if (bSize > NEWTON_DIVIDE_THRESHOLD && aSize-bSize > NEWTON_DIVIDE_THRESHOLD/2)
+	{
+		NewtonDivide(remainder, quotient, a.AbsoluteValue(), b.AbsoluteValue());
+		return;
+	}
+
 	aSize += aSize%2;	// round up to next even number
 	bSize += bSize%2;
 
@@ -1889,7 +2617,7 @@ void PositiveDivide(Integer &remainder, Integer &quotient,
 	quotient.reg.CleanNew(RoundupSize(aSize-bSize+2));
 	quotient.sign = Integer::POSITIVE;
 
-	SecWordBlock T(aSize+2*bSize+4);
+	SecBlock<word, SecBlockInlineAllocator<word, 64> > T(aSize+2*bSize+4);
 	Divide(remainder.reg, quotient.reg, T, a.reg, aSize, b.reg, bSize);
 }
 
@@ -1942,10 +2670,7 @@ word Integer::ShortDivide(Integer &quotient, const Integer &dividend, word divis
 	quotient.reg.CleanNew(RoundupSize(i));
 	word remainder = 0;
 	while (i--)
-	{
-		quotient.reg[i] = word(MAKE_DWORD(dividend.reg[i], remainder) / divisor);
-		remainder = word(MAKE_DWORD(dividend.reg[i], remainder) % divisor);
-	}
+		quotient.reg[i] = DivideDword(remainder, dividend.reg[i], remainder, divisor);
 
 	if (dividend.NotNegative())
 		quotient.sign = POSITIVE;
@@ -1995,7 +2720,7 @@ word operator%(const Integer &dividend, word divisor)
 		{
 			remainder = 0;
 			while (i--)
-				remainder = word(MAKE_DWORD(dividend.reg[i], remainder) % divisor);
+				DivideDword(remainder, dividend.reg[i], remainder, divisor);
 		}
 	}
 
@@ -2117,7 +2842,8 @@ Integer Integer::InverseMod(const Integer &m) const
 
 	SecBlock<word> T(m.reg.size * 4);
 	Integer r((word)0, m.reg.size);
-	unsigned k = AlmostInverse(r.reg, T, reg, reg.size, m.reg, m.reg.size);
+	// *this < m, but its register may still be longer than m's
+	unsigned k = AlmostInverse(r.reg, T, reg, STDMIN(reg.size, m.reg.size), m.reg, m.reg.size);
 	DivideByPower2Mod(r.reg, r.reg, k, m.reg, m.reg.size);
 	return r;
 }
@@ -2246,11 +2972,77 @@ const Integer& ModularArithmetic::Inverse(const Integer &a) const
 	return result;
 }
 
+const Integer& ModularArithmetic::Multiply(const Integer &a, const Integer &b) const
+{
+	word *const T = workspace.ptr;
+	const unsigned int N = modulus.reg.size;
+
+	if (divisionsBeforeBarrett)
+		CountDivision();
+
+	// the reducers only take products of numbers less than the modulus
+	if (a.IsNegative() || b.IsNegative() || a.reg.size>N || b.reg.size>N || a>=modulus || b>=modulus || (!reducer.get() && N>NEWTON_DIVIDE_THRESHOLD))
+		return result1 = a*b%modulus;
+
+	AsymmetricMultiply(T, T+2*N, a.reg, a.reg.size, b.reg, b.reg.size);
+	SetWords(T+a.reg.size+b.reg.size, 0, 2*N-a.reg.size-b.reg.size);
+	return ReduceProduct();
+}
+
+const Integer& ModularArithmetic::Square(const Integer &a) const
+{
+	word *const T = workspace.ptr;
+	const unsigned int N = modulus.reg.size;
+
+	if (divisionsBeforeBarrett)
+		CountDivision();
+
+	if (a.reg.size>N || a.IsNegative() || a>=modulus || (!reducer.get() && N>NEWTON_DIVIDE_THRESHOLD))
+		return result1 = a.Squared()%modulus;
+
+	RecursiveSquare(T, T+2*N, a.reg, a.reg.size);
+	SetWords(T+2*a.reg.size, 0, 2*N-2*a.reg.size);
+	return ReduceProduct();
+}
+
+// reduce the 2*N word product in workspace into result1
+const Integer& ModularArithmetic::ReduceProduct() const
+{
+	word *const T = workspace.ptr;
+	const unsigned int N = modulus.reg.size;
+
+	if (reducer.get())
+	{
+		result1.reg.New(N);
+		reducer->Reduce(result1.reg, T, T+2*N, N);
+		result1.sign = Integer::POSITIVE;
+		return result1;
+	}
+
+	unsigned int mSize = modulus.WordCount();
+
+	if (!mSize)
+		throw Integer::DivideByZero();
+	mSize += mSize%2;
+
+	result1.reg.New(N);
+	SetWords(result1.reg+mSize, 0, N-mSize);
+	CryptoPP::Divide(result1.reg.ptr, T+2*N, T+4*N+2, T, 2*N, modulus.reg, mSize);
+	result1.sign = Integer::POSITIVE;
+	return result1;
+}
+
 const Integer& ModularArithmetic::MultiplicativeInverse(const Integer &a) const
 {
 	return result1 = a.InverseMod(modulus);
 }
 
+// MultiplicativeInverse() returns zero for non-units, here and in MontgomeryRepresentation
+void ModularArithmetic::BatchInverse(Integer *elements, unsigned int count) const
+{
+	BatchInversion(*this, elements, elements+count, true);
+}
+
 Integer ModularArithmetic::Exponentiate(const Integer &a, const Integer &e) const
 {
 	if (modulus.IsOdd())
@@ -2273,15 +3065,429 @@ Integer ModularArithmetic::CascadeExponentiate(const Integer &x, const Integer &
 		return AbstractRing<Integer>::CascadeExponentiate(x, e1, y, e2);
 }
 
+// Barrett reduction beats a long division at every size, but its setup costs about as much as
+// the divisions of 6 to 33 reductions save from 160 to 2048 bit moduli, so AUTOMATIC waits this long
+static const unsigned int AUTOMATIC_BARRETT_THRESHOLD = 32;
+
+bool ModularArithmetic::HasSpecialForm(const Integer &modulus)
+{
+	// Barrett reduction is faster than folding by a c that doesn't fit in a word
+	return NISTPrimeReducer::IsNISTPrime(modulus)
+		|| (PseudoMersenneReducer::IsPseudoMersenne(modulus) && (Integer::Power2(modulus.BitCount()) - modulus).WordCount() == 1);
+}
+
+void ModularArithmetic::SetReducer(ReductionMethod newMethod)
+{
+	method = newMethod;
+	divisionsBeforeBarrett = 0;
+
+	if (method == AUTOMATIC)
+	{
+		if (HasSpecialForm(modulus))
+			method = SPECIAL_FORM;
+		else
+		{
+			method = DIVISION;
+			if (modulus > Integer::One())
+				divisionsBeforeBarrett = AUTOMATIC_BARRETT_THRESHOLD;
+		}
+	}
+
+	switch (method)
+	{
+	case BARRETT:
+		reducer.reset(new BarrettReducer(modulus));
+		break;
+	case SPECIAL_FORM:
+		if (NISTPrimeReducer::IsNISTPrime(modulus))
+			reducer.reset(new NISTPrimeReducer(modulus));
+		else if (PseudoMersenneReducer::IsPseudoMersenne(modulus))
+			reducer.reset(new PseudoMersenneReducer(modulus));
+		else
+			throw UnsupportedModulus();
+		break;
+	default:
+		reducer.reset();
+	}
+}
+
+// called before each reduction while AUTOMATIC has picked DIVISION
+void ModularArithmetic::CountDivision() const
+{
+	if (--divisionsBeforeBarrett == 0)
+	{
+		reducer.reset(new BarrettReducer(modulus));
+		method = BARRETT;
+	}
+}
+
+// ********************************************************
+
+BarrettReducer::BarrettReducer(const Integer &modulus)
+	: shift(WORD_BITS*modulus.reg.size - modulus.BitCount())
+	, m(modulus.reg.size), mu(modulus.reg.size)
+{
+	const unsigned int N = modulus.reg.size;
+	if (!modulus.IsPositive())
+		throw Integer::DivideByZero();
+
+	// normalize the modulus so that its top bit is set, then mu = 2**(2*N*WORD_BITS)/m
+	// is between 2**(N*WORD_BITS) and 2**(N*WORD_BITS+1), and only its low N words are kept
+	Integer t = modulus << shift;
+	CopyWords(m, t.reg, N);
+	t = Integer::Power2(2*N*WORD_BITS) / t;
+	if (t.BitCount() > N*WORD_BITS+1)
+		t = Integer::Power2(N*WORD_BITS+1) - 1;
+	CopyWords(mu, t.reg, N);
+}
+
+void BarrettReducer::Reduce(word *R, word *T, word *W, unsigned int N) const
+{
+	assert(N == m.size);
+	word *const Q = W, *const P = W+2*N, *const V = W+4*N;
+
+	ShiftWordsLeftByWords(T, 2*N, shift/WORD_BITS);
+	ShiftWordsLeftByBits(T, 2*N, shift%WORD_BITS);
+
+	// Q[N..2*N] = floor(T/2**(N*WORD_BITS)) * mu / 2**(N*WORD_BITS), at most 4 less than T/m
+	RecursiveMultiply(Q, V, T+N, mu, N);
+	word carry = Add(Q+N, Q+N, T+N, N);
+
+	RecursiveMultiply(P, V, Q+N, m, N);
+	if (carry)
+		Add(P+N, P+N, m, N);
+
+	// the remainder is less than 5*m, so N+2 words of it are enough
+	Subtract(T, T, P, N+2);
+	while (T[N] || T[N+1] || Compare(T, m, N) >= 0)
+		SubtractFrom(T, N+2, m, N);
+
+	ShiftWordsRightByWords(T, N, shift/WORD_BITS);
+	ShiftWordsRightByBits(T, N, shift%WORD_BITS);
+	CopyWords(R, T, N);
+}
+
+// X[NX] - X += A*B, the sum must fit in NX words
+// A[NA]
+// B[NB]
+
+static void MultiplyAccumulate(word *X, unsigned int NX, const word *A, unsigned int NA, const word *B, unsigned int NB)
+{
+	for (unsigned int i=0; i<NB; i++)
+	{
+		word carry = 0;
+		for (unsigned int j=0; j<NA; j++)
+		{
+			dword p = (dword)A[j] * B[i] + X[i+j] + carry;
+			X[i+j] = LOW_WORD(p);
+			carry = HIGH_WORD(p);
+		}
+		if (carry && i+NA<NX)
+			Increment(X+i+NA, NX-i-NA, carry);
+	}
+}
+
+bool PseudoMersenneReducer::IsPseudoMersenne(const Integer &modulus)
+{
+	unsigned int k = modulus.BitCount();
+	return k > 2*WORD_BITS && (Integer::Power2(k) - modulus).BitCount() <= k/2;
+}
+
+PseudoMersenneReducer::PseudoMersenneReducer(const Integer &modulus)
+	: k(modulus.BitCount()), m(modulus.reg.size)
+{
+	assert(IsPseudoMersenne(modulus));
+	Integer t = Integer::Power2(k) - modulus;
+	c.New(t.WordCount());
+	CopyWords(m, modulus.reg, m.size);
+	CopyWords(c, t.reg, c.size);
+}
+
+void PseudoMersenneReducer::Reduce(word *R, word *T, word *W, unsigned int N) const
+{
+	assert(N == m.size);
+	const unsigned int kw = k/WORD_BITS, kb = k%WORD_BITS;
+	unsigned int n = CountWords(T, 2*N);
+
+	// 2**k = c mod m, so fold the bits above k back down multiplied by c,
+	// each fold shrinks the number by at least k/2 bits
+	while (n > kw+1 || (n == kw+1 && T[kw] >> kb))
+	{
+		unsigned int hn = n - kw;
+		CopyWords(W, T+kw, hn);
+		ShiftWordsRightByBits(W, hn, kb);
+		hn = CountWords(W, hn);
+
+		if (kb)
+		{
+			T[kw] &= (word(1) << kb) - 1;
+			SetWords(T+kw+1, 0, n-kw-1);
+		}
+		else
+			SetWords(T+kw, 0, n-kw);
+
+		MultiplyAccumulate(T, n, W, hn, c, c.size);
+		n = CountWords(T, n);
+	}
+
+	// now T < 2**k < 2*m
+	if (Compare(T, m, N) >= 0)
+		Subtract(T, T, m, N);
+	CopyWords(R, T, N);
+}
+
+static const unsigned int NISTPrimeBits[] = {192, 224, 256, 384};
+
+static Integer NISTPrime(unsigned int index)
+{
+	switch (index)
+	{
+	case 0:
+		return Integer::Power2(192) - Integer::Power2(64) - 1;
+	case 1:
+		return Integer::Power2(224) - Integer::Power2(96) + 1;
+	case 2:
+		return Integer::Power2(256) - Integer::Power2(224) + Integer::Power2(192) + Integer::Power2(96) - 1;
+	default:
+		return Integer::Power2(384) - Integer::Power2(128) - Integer::Power2(96) + Integer::Power2(32) - 1;
+	}
+}
+
+static int NISTPrimeIndex(const Integer &modulus)
+{
+	for (unsigned int i=0; i<sizeof(NISTPrimeBits)/sizeof(NISTPrimeBits[0]); i++)
+		if (modulus.BitCount() == NISTPrimeBits[i] && modulus == NISTPrime(i))
+			return i;
+	return -1;
+}
+
+static inline word GetChunk32(const word *X, unsigned int i)
+{
+	return word32(X[i*32/WORD_BITS] >> (i*32%WORD_BITS));
+}
+
+// X must be zero in chunk i
+static inline void SetChunk32(word *X, unsigned int i, word c)
+{
+	X[i*32/WORD_BITS] |= c << (i*32%WORD_BITS);
+}
+
+// the number of words for CHUNKS 32-bit chunks and a sign word
+#define NIST_REDUCTION_WORDS(CHUNKS) ((CHUNKS*32 + WORD_BITS-1)/WORD_BITS + 1)
+
+// fixed-size versions of Add(), Subtract() and Compare(), which the compiler can unroll
+
+template <unsigned int L> static inline void AddFixed(word *A, const word *B)
+{
+	word carry = 0;
+	for (unsigned int i=0; i<L; i++)
+	{
+		dword t = (dword)A[i] + B[i] + carry;
+		A[i] = LOW_WORD(t);
+		carry = HIGH_WORD(t);
+	}
+}
+
+template <unsigned int L> static inline void SubtractFixed(word *A, const word *B)
+{
+	word borrow = 0;
+	for (unsigned int i=0; i<L; i++)
+	{
+		dword t = (dword)A[i] - B[i] - borrow;
+		A[i] = LOW_WORD(t);
+		borrow = 0-HIGH_WORD(t);
+	}
+}
+
+template <unsigned int L> static inline bool LessFixed(const word *A, const word *B)
+{
+	for (unsigned int i=L; i--; )
+		if (A[i] != B[i])
+			return A[i] < B[i];
+	return false;
+}
+
+// R[N] = the sum of the 32-bit columns s[0..CHUNKS) mod m, each column sum in two's complement,
+// m has NIST_REDUCTION_WORDS(CHUNKS) words
+template <unsigned int CHUNKS> static inline void FinishNISTReduction(word *R, const word64 *s, const word *m, unsigned int N)
+{
+	const unsigned int L = NIST_REDUCTION_WORDS(CHUNKS);
+	word A[L], S[L];
+	unsigned int i;
+
+	// carry the columns into A in two's complement, acc is shifted right arithmetically
+	SetWords(A, 0, L);
+	word64 acc = 0, top = 0;
+	for (i=0; i<L*WORD_BITS/32; i++)
+	{
+		if (i < CHUNKS)
+			acc += s[i];
+		else if (i == CHUNKS)
+			top = acc;
+		SetChunk32(A, i, word32(acc));
+		acc = (acc >> 32) | ((0-(acc >> 63)) << 32);
+	}
+
+	// A is within a few m of 0 after subtracting top*m, where top is the carry out of the chunks
+	const bool negative = (top >> 63) != 0;
+	const word carry = word(negative ? 0-top : top);
+	dword t = 0;
+	for (i=0; i<L; i++)
+	{
+		t += (dword)m[i] * carry;
+		S[i] = LOW_WORD(t);
+		t = HIGH_WORD(t);
+	}
+	if (negative)
+		AddFixed<L>(A, S);
+	else
+		SubtractFixed<L>(A, S);
+
+	while (A[L-1] >> (WORD_BITS-1))
+		AddFixed<L>(A, m);
+	while (!LessFixed<L>(A, m))
+		SubtractFixed<L>(A, m);
+
+	CopyWords(R, A, STDMIN(N, L));
+	if (N > L)
+		SetWords(R+L, 0, N-L);
+}
+
+// the reduction formulas of FIPS 186-2 appendix 6, summed one 32-bit column at a time,
+// T is the product, ci is its i-th 32-bit chunk
+
+// P-192 = 2**192 - 2**64 - 1
+static void ReduceP192(word *R, const word *T, const word *m, unsigned int N)
+{
+	const word64 c0 = GetChunk32(T, 0), c1 = GetChunk32(T, 1), c2 = GetChunk32(T, 2), c3 = GetChunk32(T, 3);
+	const word64 c4 = GetChunk32(T, 4), c5 = GetChunk32(T, 5), c6 = GetChunk32(T, 6), c7 = GetChunk32(T, 7);
+	const word64 c8 = GetChunk32(T, 8), c9 = GetChunk32(T, 9), c10 = GetChunk32(T, 10), c11 = GetChunk32(T, 11);
+	word64 s[6];
+
+	s[0] = c0 + c6 + c10;
+	s[1] = c1 + c7 + c11;
+	s[2] = c2 + c6 + c8 + c10;
+	s[3] = c3 + c7 + c9 + c11;
+	s[4] = c4 + c8 + c10;
+	s[5] = c5 + c9 + c11;
+	FinishNISTReduction<6>(R, s, m, N);
+}
+
+// P-224 = 2**224 - 2**96 + 1
+static void ReduceP224(word *R, const word *T, const word *m, unsigned int N)
+{
+	const word64 c0 = GetChunk32(T, 0), c1 = GetChunk32(T, 1), c2 = GetChunk32(T, 2), c3 = GetChunk32(T, 3);
+	const word64 c4 = GetChunk32(T, 4), c5 = GetChunk32(T, 5), c6 = GetChunk32(T, 6), c7 = GetChunk32(T, 7);
+	const word64 c8 = GetChunk32(T, 8), c9 = GetChunk32(T, 9), c10 = GetChunk32(T, 10), c11 = GetChunk32(T, 11);
+	const word64 c12 = GetChunk32(T, 12), c13 = GetChunk32(T, 13);
+	word64 s[7];
+
+	s[0] = c0 - c7 - c11;
+	s[1] = c1 - c8 - c12;
+	s[2] = c2 - c9 - c13;
+	s[3] = c3 + c7 + c11 - c10;
+	s[4] = c4 + c8 + c12 - c11;
+	s[5] = c5 + c9 + c13 - c12;
+	s[6] = c6 + c10 - c13;
+	FinishNISTReduction<7>(R, s, m, N);
+}
+
+// P-256 = 2**256 - 2**224 + 2**192 + 2**96 - 1
+static void ReduceP256(word *R, const word *T, const word *m, unsigned int N)
+{
+	const word64 c0 = GetChunk32(T, 0), c1 = GetChunk32(T, 1), c2 = GetChunk32(T, 2), c3 = GetChunk32(T, 3);
+	const word64 c4 = GetChunk32(T, 4), c5 = GetChunk32(T, 5), c6 = GetChunk32(T, 6), c7 = GetChunk32(T, 7);
+	const word64 c8 = GetChunk32(T, 8), c9 = GetChunk32(T, 9), c10 = GetChunk32(T, 10), c11 = GetChunk32(T, 11);
+	const word64 c12 = GetChunk32(T, 12), c13 = GetChunk32(T, 13), c14 = GetChunk32(T, 14), c15 = GetChunk32(T, 15);
+	word64 s[8];
+
+	s[0] = c0 + c8 + c9 - c11 - c12 - c13 - c14;
+	s[1] = c1 + c9 + c10 - c12 - c13 - c14 - c15;
+	s[2] = c2 + c10 + c11 - c13 - c14 - c15;
+	s[3] = c3 + 2*c11 + 2*c12 + c13 - c8 - c9 - c15;
+	s[4] = c4 + 2*c12 + 2*c13 + c14 - c9 - c10;
+	s[5] = c5 + 2*c13 + 2*c14 + c15 - c10 - c11;
+	s[6] = c6 + c13 + 3*c14 + 2*c15 - c8 - c9;
+	s[7] = c7 + c8 + 3*c15 - c10 - c11 - c12 - c13;
+	FinishNISTReduction<8>(R, s, m, N);
+}
+
+// P-384 = 2**384 - 2**128 - 2**96 + 2**32 - 1
+static void ReduceP384(word *R, const word *T, const word *m, unsigned int N)
+{
+	const word64 c0 = GetChunk32(T, 0), c1 = GetChunk32(T, 1), c2 = GetChunk32(T, 2), c3 = GetChunk32(T, 3);
+	const word64 c4 = GetChunk32(T, 4), c5 = GetChunk32(T, 5), c6 = GetChunk32(T, 6), c7 = GetChunk32(T, 7);
+	const word64 c8 = GetChunk32(T, 8), c9 = GetChunk32(T, 9), c10 = GetChunk32(T, 10), c11 = GetChunk32(T, 11);
+	const word64 c12 = GetChunk32(T, 12), c13 = GetChunk32(T, 13), c14 = GetChunk32(T, 14), c15 = GetChunk32(T, 15);
+	const word64 c16 = GetChunk32(T, 16), c17 = GetChunk32(T, 17), c18 = GetChunk32(T, 18), c19 = GetChunk32(T, 19);
+	const word64 c20 = GetChunk32(T, 20), c21 = GetChunk32(T, 21), c22 = GetChunk32(T, 22), c23 = GetChunk32(T, 23);
+	word64 s[12];
+
+	s[0] = c0 + c12 + c20 + c21 - c23;
+	s[1] = c1 + c13 + c22 + c23 - c12 - c20;
+	s[2] = c2 + c14 + c23 - c13 - c21;
+	s[3] = c3 + c12 + c15 + c20 + c21 - c14 - c22 - c23;
+	s[4] = c4 + c12 + c13 + c16 + c20 + 2*c21 + c22 - c15 - 2*c23;
+	s[5] = c5 + c13 + c14 + c17 + c21 + 2*c22 + c23 - c16;
+	s[6] = c6 + c14 + c15 + c18 + c22 + 2*c23 - c17;
+	s[7] = c7 + c15 + c16 + c19 + c23 - c18;
+	s[8] = c8 + c16 + c17 + c20 - c19;
+	s[9] = c9 + c17 + c18 + c21 - c20;
+	s[10] = c10 + c18 + c19 + c22 - c21;
+	s[11] = c11 + c19 + c20 + c23 - c22;
+	FinishNISTReduction<12>(R, s, m, N);
+}
+
+bool NISTPrimeReducer::IsNISTPrime(const Integer &modulus)
+{
+	return WORD_BITS%32 == 0 && NISTPrimeIndex(modulus) >= 0;
+}
+
+NISTPrimeReducer::NISTPrimeReducer(const Integer &modulus)
+	: index(NISTPrimeIndex(modulus))
+{
+	assert(IsNISTPrime(modulus));
+	m.New(NIST_REDUCTION_WORDS(NISTPrimeBits[index]/32));
+	SetWords(m, 0, m.size);
+	CopyWords(m, modulus.reg, STDMIN(m.size, modulus.WordCount()));
+}
+
+void NISTPrimeReducer::Reduce(word *R, word *T, word *W, unsigned int N) const
+{
+	switch (index)
+	{
+	case 0:
+		ReduceP192(R, T, m, N);
+		break;
+	case 1:
+		ReduceP224(R, T, m, N);
+		break;
+	case 2:
+		ReduceP256(R, T, m, N);
+		break;
+	default:
+		ReduceP384(R, T, m, N);
+	}
+}
+
+// ********************************************************
+
 MontgomeryRepresentation::MontgomeryRepresentation(const Integer &m)	// modulus must be odd
-	: ModularArithmetic(m),
-	  u((word)0, modulus.reg.size),
-	  workspace(5*modulus.reg.size)
+	: ModularArithmetic(m, DIVISION),
+	  u((word)0, modulus.reg.size)
 {
 	assert(modulus.IsOdd());
 	RecursiveInverseModPower2(u.reg, workspace, modulus.reg, modulus.reg.size);
 }
 
+// copy u word for word, since Integer's copy constructor may shorten it
+MontgomeryRepresentation::MontgomeryRepresentation(const MontgomeryRepresentation &mr)
+	: ModularArithmetic(mr),
+	  u((word)0, modulus.reg.size)
+{
+	CopyWords(u.reg, mr.u.reg, modulus.reg.size);
+}
+
 const Integer& MontgomeryRepresentation::Multiply(const Integer &a, const Integer &b) const
 {
 	word *const T = workspace.ptr;
@@ -2308,6 +3514,80 @@ const Integer& MontgomeryRepresentation::Square(const Integer &a) const
 	return result;
 }
 
+// R[N] --- result = A*B/(2**(WORD_BITS*N)) mod M, R may overlap A or B
+// T[5*N] - temporary work space
+
+static void MontgomeryMultiply(word *R, word *T, const word *A, const word *B, const word *M, const word *U, unsigned int N)
+{
+	if (A == B)
+		RecursiveSquare(T, T+2*N, A, N);
+	else
+		RecursiveMultiply(T, T+2*N, A, B, N);
+	MontgomeryReduce(R, T+2*N, T, M, U, N);
+}
+
+// R[N] --- result = table entry i, reading every entry so that
+//			the memory access pattern doesn't depend on i
+
+static void SelectWords(word *R, const word *table, unsigned int count, unsigned int i, unsigned int N)
+{
+	SetWords(R, 0, N);
+	for (unsigned int j=0; j<count; j++)
+	{
+		const word mask = word(0) - word(i==j);
+		for (unsigned int k=0; k<N; k++)
+			R[k] |= table[j*N+k] & mask;
+	}
+}
+
+// same window schedule as AbstractRing<T>::FixedWindowExponentiate(), but
+// works on full length operands and never indexes the table by exponent bits
+Integer MontgomeryRepresentation::FixedWindowExponentiate(const Integer &a, const Integer &e, unsigned int expLen) const
+{
+	assert(e.NotNegative());
+	expLen = STDMAX(expLen, e.BitCount());
+	if (expLen==0)
+		return One();
+
+	word *const T = workspace.ptr;
+	const unsigned int N = modulus.reg.size;
+	assert(a.WordCount()<=N);
+
+	const unsigned int w = (expLen <= 24 ? 2 : (expLen <= 96 ? 3 : (expLen <= 320 ? 4 : (expLen <= 960 ? 5 : 6))));
+	const unsigned int tableSize = 1<<w;
+	SecWordBlock table(tableSize*N), x(N);
+	Integer r((word)0, N);
+
+	const Integer &one = One();
+	SetWords(table, 0, 2*N);
+	CopyWords(table, one.reg, one.WordCount());
+	CopyWords(table+N, a.reg, a.WordCount());
+	unsigned int i;
+	for (i=2; i<tableSize; i++)
+		MontgomeryMultiply(table+i*N, T, table+(i-1)*N, table+N, modulus.reg, u.reg, N);
+
+	const unsigned int windows = (expLen+w-1)/w;
+	unsigned int window = 0;
+	int j, k;
+
+	for (k=w-1; k>=0; k--)
+		window = 2*window + e.GetBit((windows-1)*w+k);
+	SelectWords(r.reg, table, tableSize, window, N);
+
+	for (j=windows-2; j>=0; j--)
+	{
+		window = 0;
+		for (k=w-1; k>=0; k--)
+		{
+			MontgomeryMultiply(r.reg, T, r.reg, r.reg, modulus.reg, u.reg, N);
+			window = 2*window + e.GetBit(j*w+k);
+		}
+		SelectWords(x, table, tableSize, window, N);
+		MontgomeryMultiply(r.reg, T, r.reg, x, modulus.reg, u.reg, N);
+	}
+	return r;
+}
+
 Integer MontgomeryRepresentation::ConvertOut(const Integer &a) const
 {
 	word *const T = workspace.ptr;
@@ -312,6 +312,9 @@ private:
 	friend class ModularArithmetic;
 	friend class MontgomeryRepresentation;
 	friend class HalfMontgomeryRepresentation;
+	friend class BarrettReducer;
+	friend class PseudoMersenneReducer;
+	friend class NISTPrimeReducer;
 
 	Integer(word value, unsigned int length);
 
@@ -323,7 +326,8 @@ private:
 
 	enum Sign {POSITIVE=0, NEGATIVE=1};
 
-	SecWordBlock reg;
+	// values of up to 8 words don't need heap allocation
+	SecBlock<word, SecBlockInlineAllocator<word, 8> > reg;
 	Sign sign;
 };
 
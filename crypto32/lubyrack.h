@@ -22,9 +22,6 @@ protected:
 	const unsigned int S;    // block size / 2
 	const unsigned int L;    // key length / 2
 	SecByteBlock key;
-
-	mutable T hm;
-	mutable SecByteBlock buffer;
 };
 
 template <class T> class LREncryption : public LRBase<T>
@@ -54,7 +51,7 @@ public:
 };
 
 template <class T> LRBase<T>::LRBase(const byte *userKey, unsigned int keyLen)
-: S(T::DIGESTSIZE), L(keyLen/2), key(2*L), buffer(2*S)
+: S(T::DIGESTSIZE), L(keyLen/2), key(2*L)
 {
 	memcpy(key, userKey, 2*L);
 }
@@ -68,8 +65,12 @@ template <class T> LRBase<T>::LRBase(const byte *userKey, unsigned int keyLen)
 #define OL outBlock
 #define OR outBlock+S
 
+// the hash and the buffer are locals, so one key can process blocks on several threads at once
 template <class T> void LREncryption<T>::ProcessBlock(const byte *inBlock, byte * outBlock) const
 {
+	T hm;
+	byte buffer[2*T::DIGESTSIZE];
+
 	hm.Update(KL, L);
 	hm.Update(IL, S);
 	hm.Final(BR);
@@ -93,6 +94,9 @@ template <class T> void LREncryption<T>::ProcessBlock(const byte *inBlock, byte
 
 template <class T> void LRDecryption<T>::ProcessBlock(const byte *inBlock, byte * outBlock) const
 {
+	T hm;
+	byte buffer[2*T::DIGESTSIZE];
+
 	hm.Update(KR, L);
 	hm.Update(IR, S);
 	hm.Final(BL);
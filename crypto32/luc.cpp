@@ -5,6 +5,7 @@
 #include "asn.h"
 #include "nbtheory.h"
 #include "sha.h"
+#include "thread.h"
 
 #include "pubkey.cpp"
 #include "oaep.cpp"
@@ -13,12 +14,18 @@ NAMESPACE_BEGIN(CryptoPP)
 
 INSTANTIATE_PUBKEY_TEMPLATES_MACRO(OAEP<SHA>, PKCS_SignaturePaddingScheme, LUCFunction, InvertibleLUCFunction);
 
+LUCFunction::LUCFunction(const Integer &n, const Integer &e)
+	: n(n), e(e), nmr(new MontgomeryRepresentation(n))
+{
+}
+
 LUCFunction::LUCFunction(BufferedTransformation &bt)
 {
 	BERSequenceDecoder seq(bt);
 	n.BERDecode(seq);
 	e.BERDecode(seq);
 	seq.OutputFinished();
+	nmr.reset(new MontgomeryRepresentation(n));
 }
 
 void LUCFunction::DEREncode(BufferedTransformation &bt) const
@@ -31,7 +38,32 @@ void LUCFunction::DEREncode(BufferedTransformation &bt) const
 
 Integer LUCFunction::ApplyFunction(const Integer &x) const
 {
-	return Lucas(e, x, n);
+	MontgomeryRepresentation mr(*nmr);
+	return Lucas(e, x, mr);
+}
+
+class LUCFunction::ApplyBatch : public BatchProcessor
+{
+public:
+	ApplyBatch(const LUCFunction &f, Integer *y, const Integer *x)
+		: f(f), y(y), x(x) {}
+
+	void ProcessBatch(unsigned int begin, unsigned int count) const
+	{
+		MontgomeryRepresentation mr(*f.nmr);
+		for (unsigned int i=begin; i<begin+count; i++)
+			y[i] = Lucas(f.e, x[i], mr);
+	}
+
+private:
+	const LUCFunction &f;
+	Integer *y;
+	const Integer *x;
+};
+
+void LUCFunction::ApplyFunctions(Integer *y, const Integer *x, unsigned int count, unsigned int threadCount) const
+{
+	RunBatch(ApplyBatch(*this, y, x), count, threadCount);
 }
 
 // *****************************************************************************
@@ -43,6 +75,8 @@ InvertibleLUCFunction::InvertibleLUCFunction(const Integer &nIn, const Integer &
 {
 	assert(p*q==n);
 	assert(u*q%p==1);
+
+	Precompute();
 }
 
 // generate a random private key
@@ -72,6 +106,9 @@ InvertibleLUCFunction::InvertibleLUCFunction(RandomNumberGenerator &rng, unsigne
 	u = EuclideanMultiplicativeInverse(q, p);
 	n = p * q;
 	assert(n.BitCount() == keybits);
+
+	nmr.reset(new MontgomeryRepresentation(n));
+	Precompute();
 }
 
 InvertibleLUCFunction::InvertibleLUCFunction(BufferedTransformation &bt)
@@ -88,6 +125,9 @@ InvertibleLUCFunction::InvertibleLUCFunction(BufferedTransformation &bt)
 	q.BERDecode(seq);
 	u.BERDecode(seq);
 	seq.OutputFinished();
+
+	nmr.reset(new MontgomeryRepresentation(n));
+	Precompute();
 }
 
 void InvertibleLUCFunction::DEREncode(BufferedTransformation &bt) const
@@ -104,9 +144,57 @@ void InvertibleLUCFunction::DEREncode(BufferedTransformation &bt) const
 	seq.InputFinished();
 }
 
+void InvertibleLUCFunction::Precompute()
+{
+	dpm = EuclideanMultiplicativeInverse(e, p-1);
+	dpp = EuclideanMultiplicativeInverse(e, p+1);
+	dqm = EuclideanMultiplicativeInverse(e, q-1);
+	dqp = EuclideanMultiplicativeInverse(e, q+1);
+	pmr.reset(new MontgomeryRepresentation(p));
+	qmr.reset(new MontgomeryRepresentation(q));
+}
+
 Integer InvertibleLUCFunction::CalculateInverse(const Integer &x) const
 {
-	 return InverseLucas(e, x, q, p, u);
+	MontgomeryRepresentation pmr(*this->pmr), qmr(*this->qmr);
+	return CalculateInverse(x, pmr, qmr);
+}
+
+Integer InvertibleLUCFunction::CalculateInverse(const Integer &x, const MontgomeryRepresentation &pmr, const MontgomeryRepresentation &qmr) const
+{
+	const Integer d = x*x-4;
+	const int jp = Jacobi(d, p), jq = Jacobi(d, q);
+	if (jp==0 || jq==0)
+		return InverseLucas(e, x, q, p, u);
+
+	// u is the inverse of q mod p, so q goes first
+	Integer xp = Lucas(jp==1 ? dpm : dpp, x, pmr);
+	Integer xq = Lucas(jq==1 ? dqm : dqp, x, qmr);
+	return CRT(xq, q, xp, p, u);
+}
+
+class InvertibleLUCFunction::InverseBatch : public BatchProcessor
+{
+public:
+	InverseBatch(const InvertibleLUCFunction &f, Integer *y, const Integer *x)
+		: f(f), y(y), x(x) {}
+
+	void ProcessBatch(unsigned int begin, unsigned int count) const
+	{
+		MontgomeryRepresentation pmr(*f.pmr), qmr(*f.qmr);
+		for (unsigned int i=begin; i<begin+count; i++)
+			y[i] = f.CalculateInverse(x[i], pmr, qmr);
+	}
+
+private:
+	const InvertibleLUCFunction &f;
+	Integer *y;
+	const Integer *x;
+};
+
+void InvertibleLUCFunction::CalculateInverses(Integer *y, const Integer *x, unsigned int count, unsigned int threadCount) const
+{
+	RunBatch(InverseBatch(*this, y, x), count, threadCount);
 }
 
 // ********************************************************
@@ -356,7 +444,7 @@ void LUCELG_DigestSigner::RawSign(RandomNumberGenerator &rng, const Integer &m,
 // ********************************************************
 
 LUCDIF::LUCDIF(const Integer &p, const Integer &g)
-	: p(p), g(g)
+	: p(p), g(g), pmr(new MontgomeryRepresentation(p))
 {
 }
 
@@ -365,6 +453,7 @@ LUCDIF::LUCDIF(RandomNumberGenerator &rng, unsigned int pbits)
 	PrimeAndGenerator pg(-1, rng, pbits);
 	p = pg.Prime();
 	g = pg.Generator();
+	pmr.reset(new MontgomeryRepresentation(p));
 }
 
 LUCDIF::LUCDIF(BufferedTransformation &bt)
@@ -373,6 +462,7 @@ LUCDIF::LUCDIF(BufferedTransformation &bt)
 	p.BERDecode(seq);
 	g.BERDecode(seq);
 	seq.OutputFinished();
+	pmr.reset(new MontgomeryRepresentation(p));
 }
 
 void LUCDIF::DEREncode(BufferedTransformation &bt) const
@@ -391,7 +481,8 @@ bool LUCDIF::ValidateDomainParameters(RandomNumberGenerator &rng) const
 void LUCDIF::GenerateKeyPair(RandomNumberGenerator &rng, byte *privateKey, byte *publicKey) const
 {
 	Integer x(rng, ExponentBitLength());
-	Integer y = Lucas(x, g, p);
+	MontgomeryRepresentation mr(*pmr);
+	Integer y = Lucas(x, g, mr);
 	x.Encode(privateKey, PrivateKeyLength());
 	y.Encode(publicKey, PublicKeyLength());
 }
@@ -405,7 +496,8 @@ bool LUCDIF::Agree(byte *agreedValue, const byte *privateKey, const byte *otherP
 		return false;
 
 	Integer s(privateKey, PrivateKeyLength());
-	Integer z = Lucas(s, w, p);
+	MontgomeryRepresentation mr(*pmr);
+	Integer z = Lucas(s, w, mr);
 	z.Encode(agreedValue, AgreedValueLength());
 	return true;
 }
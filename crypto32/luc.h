@@ -4,6 +4,8 @@
 #include "pkcspad.h"
 #include "oaep.h"
 #include "integer.h"
+#include "modarith.h"
+#include "smartptr.h"
 
 #include <limits.h>
 
@@ -12,17 +14,24 @@ NAMESPACE_BEGIN(CryptoPP)
 class LUCFunction : virtual public TrapdoorFunction
 {
 public:
-	LUCFunction(const Integer &n, const Integer &e) : n(n), e(e) {}
+	LUCFunction(const Integer &n, const Integer &e);
 	LUCFunction(BufferedTransformation &bt);
 	void DEREncode(BufferedTransformation &bt) const;
 
 	Integer ApplyFunction(const Integer &x) const;
+	// sets y[i] = ApplyFunction(x[i]) for each i < count, dividing the work among
+	// threadCount threads, including the calling one
+	void ApplyFunctions(Integer *y, const Integer *x, unsigned int count, unsigned int threadCount) const;
 	Integer MaxPreimage() const {return n-1;}
 	Integer MaxImage() const {return n-1;}
 
 protected:
 	LUCFunction() {}	// to be used only by InvertibleLUCFunction
+
+	class ApplyBatch;
+
 	Integer n, e;	// these are only modified in constructors
+	value_ptr<MontgomeryRepresentation> nmr;	// precomputed for n
 };
 
 class InvertibleLUCFunction : public LUCFunction, public InvertibleTrapdoorFunction
@@ -36,9 +45,20 @@ public:
 	void DEREncode(BufferedTransformation &bt) const;
 
 	Integer CalculateInverse(const Integer &x) const;
+	// sets y[i] = CalculateInverse(x[i]) for each i < count, dividing the work among
+	// threadCount threads, including the calling one
+	void CalculateInverses(Integer *y, const Integer *x, unsigned int count, unsigned int threadCount) const;
 
 protected:
+	void Precompute();
+	Integer CalculateInverse(const Integer &x, const MontgomeryRepresentation &pmr, const MontgomeryRepresentation &qmr) const;
+
+	class InverseBatch;
+
 	Integer p, q, u;
+	// inverses of e mod p-1, p+1, q-1 and q+1, the Jacobi symbol of x*x-4 picks one of each pair
+	Integer dpm, dpp, dqm, dqp;
+	value_ptr<MontgomeryRepresentation> pmr, qmr;
 };
 
 template <class B>
@@ -229,6 +249,7 @@ private:
 	unsigned int ExponentBitLength() const;
 
 	Integer p, g;
+	value_ptr<MontgomeryRepresentation> pmr;	// precomputed for p
 };
 
 NAMESPACE_END
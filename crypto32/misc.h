@@ -349,21 +349,106 @@ inline void PutBlockBigEndian(byte *block, T a, T b, T c, T d)
 #ifdef SECALLOC_DEFAULT
 #define SecAlloc(type, number) (new type[(number)])
 #define SecFree(ptr, number) (memset((ptr), 0, (number)*sizeof(*(ptr))), delete [] (ptr))
+#define SecWipe(ptr, number) memset((ptr), 0, (number)*sizeof(*(ptr)))
 #else
 #define SecAlloc(type, number) (new type[(number)])
 #define SecFree(ptr, number) (delete [] (ptr))
+#define SecWipe(ptr, number) ((void)0)
 #endif
 
-template <class T> struct SecBlock
+// the default allocation policy of SecBlock, which keeps every block on the heap
+template <class T> class SecBlockHeapAllocator
+{
+public:
+	T *Allocate(unsigned int n)
+		{return SecAlloc(T, n);}
+	void Deallocate(T *p, unsigned int n)
+		{SecFree(p, n);}
+
+	// returns a block of newSize elements for p's block of size, keeping the
+	// first elements if preserve is set
+	T *Reallocate(T *p, unsigned int size, unsigned int newSize, bool preserve)
+	{
+		T *newPtr = SecAlloc(T, newSize);
+		if (preserve)
+			memcpy(newPtr, p, STDMIN(newSize, size)*sizeof(T));
+		SecFree(p, size);
+		return newPtr;
+	}
+
+	// swaps the block p of size held by this allocator with b's block q of bSize
+	void Swap(T *&p, unsigned int size, SecBlockHeapAllocator<T> &b, T *&q, unsigned int bSize)
+		{std::swap(p, q);}
+};
+
+// an allocation policy of SecBlock that keeps blocks of up to S elements inside
+// the SecBlock itself instead of on the heap, elements of the buffer that a block
+// no longer uses are wiped when it shrinks or moves, as SecFree() wipes the heap
+template <class T, unsigned int S> class SecBlockInlineAllocator
+{
+public:
+	T *Allocate(unsigned int n)
+		{return n <= S ? m_buf : SecAlloc(T, n);}
+
+	void Deallocate(T *p, unsigned int n)
+	{
+		if (p != m_buf)
+			SecFree(p, n);
+		else
+			SecWipe(p, n);
+	}
+
+	T *Reallocate(T *p, unsigned int size, unsigned int newSize, bool preserve)
+	{
+		if (p == m_buf && newSize <= S)
+		{
+			if (newSize < size)
+				SecWipe(p+newSize, size-newSize);
+			return p;
+		}
+		T *newPtr = Allocate(newSize);
+		if (preserve)
+			memcpy(newPtr, p, STDMIN(newSize, size)*sizeof(T));
+		Deallocate(p, size);
+		return newPtr;
+	}
+
+	void Swap(T *&p, unsigned int size, SecBlockInlineAllocator<T, S> &b, T *&q, unsigned int bSize)
+	{
+		if (p != m_buf && q != b.m_buf)
+			std::swap(p, q);
+		else if (p == m_buf && q == b.m_buf)
+			std::swap_ranges(m_buf, m_buf+STDMAX(size, bSize), b.m_buf);
+		else if (p == m_buf)
+		{
+			memcpy(b.m_buf, m_buf, size*sizeof(T));
+			SecWipe(m_buf, size);
+			p = q;
+			q = b.m_buf;
+		}
+		else
+		{
+			memcpy(m_buf, b.m_buf, bSize*sizeof(T));
+			SecWipe(b.m_buf, bSize);
+			q = p;
+			p = m_buf;
+		}
+	}
+
+private:
+	T m_buf[S];
+};
+
+template <class T, class A = SecBlockHeapAllocator<T> > struct SecBlock
 {
 	SecBlock(unsigned int size=0)
-		: size(size) {ptr = SecAlloc(T, size);}
-	SecBlock(const SecBlock<T> &t)
-		: size(t.size) {ptr = SecAlloc(T, size); CopyFrom(t);}
+		: size(size) {ptr = alloc.Allocate(size);}
+	SecBlock(const SecBlock<T, A> &t)
+		: size(t.size) {ptr = alloc.Allocate(size); memcpy(ptr, t.ptr, size*sizeof(T));}
 	SecBlock(const T *t, unsigned int size)
-		: size(size) {ptr = SecAlloc(T, size); memcpy(ptr, t, size*sizeof(T));}
+		: size(size) {ptr = alloc.Allocate(size); memcpy(ptr, t, size*sizeof(T));}
 	~SecBlock()
-		{SecFree(ptr, size);}
+		{alloc.Deallocate(ptr, size);}
 
 #if defined(__GNUC__) || defined(__BCPLUSPLUS__)
 	operator const void *() const
@@ -398,19 +483,19 @@ template <class T> struct SecBlock
 	T* End()
 		{return ptr+size;}
 
-	void CopyFrom(const SecBlock<T> &t)
+	void CopyFrom(const SecBlock<T, A> &t)
 	{
 		New(t.size);
 		memcpy(ptr, t.ptr, size*sizeof(T));
 	}
 
-	SecBlock& operator=(const SecBlock<T> &t)
+	SecBlock& operator=(const SecBlock<T, A> &t)
 	{
 		CopyFrom(t);
 		return *this;
 	}
 
-	bool operator==(const SecBlock<T> &t) const
+	bool operator==(const SecBlock<T, A> &t) const
 	{
 		return size == t.size && memcmp(ptr, t.ptr, size*sizeof(T)) == 0;
 	}
@@ -418,74 +503,55 @@ template <class T> struct SecBlock
 	void New(unsigned int newSize)
 	{
 		if (newSize != size)
-		{
-			T *newPtr = SecAlloc(T, newSize);
-			SecFree(ptr, size);
-			ptr = newPtr;
-			size = newSize;
-		}
+			Reallocate(newSize, false);
 	}
 
 	void CleanNew(unsigned int newSize)
 	{
-		if (newSize != size)
-		{
-			T *newPtr = SecAlloc(T, newSize);
-			SecFree(ptr, size);
-			ptr = newPtr;
-			size = newSize;
-		}
+		New(newSize);
 		memset(ptr, 0, size*sizeof(T));
 	}
 
 	void Grow(unsigned int newSize)
 	{
 		if (newSize > size)
-		{
-			T *newPtr = SecAlloc(T, newSize);
-			memcpy(newPtr, ptr, size*sizeof(T));
-			SecFree(ptr, size);
-			ptr = newPtr;
-			size = newSize;
-		}
+			Reallocate(newSize, true);
 	}
 
 	void CleanGrow(unsigned int newSize)
 	{
 		if (newSize > size)
 		{
-			T *newPtr = SecAlloc(T, newSize);
-			memcpy(newPtr, ptr, size*sizeof(T));
-			memset(newPtr+size, 0, (newSize-size)*sizeof(T));
-			SecFree(ptr, size);
-			ptr = newPtr;
-			size = newSize;
+			unsigned int oldSize = size;
+			Reallocate(newSize, true);
+			memset(ptr+oldSize, 0, (newSize-oldSize)*sizeof(T));
 		}
 	}
 
 	void Resize(unsigned int newSize)
 	{
 		if (newSize != size)
-		{
-			T *newPtr = SecAlloc(T, newSize);
-			memcpy(newPtr, ptr, STDMIN(newSize, size)*sizeof(T));
-			SecFree(ptr, size);
-			ptr = newPtr;
-			size = newSize;
-		}
+			Reallocate(newSize, true);
 	}
 
-	void swap(SecBlock<T> &b);
+	void swap(SecBlock<T, A> &b)
+	{
+		alloc.Swap(ptr, size, b.alloc, b.ptr, b.size);
+		std::swap(size, b.size);
+	}
 
 	unsigned int size;
 	T *ptr;
-};
 
-template <class T> void SecBlock<T>::swap(SecBlock<T> &b)
-{
-	std::swap(size, b.size);
-	std::swap(ptr, b.ptr);
-}
+private:
+	void Reallocate(unsigned int newSize, bool preserve)
+	{
+		ptr = alloc.Reallocate(ptr, size, newSize, preserve);
+		size = newSize;
+	}
+
+	A alloc;
+};
 
 typedef SecBlock<byte> SecByteBlock;
 typedef SecBlock<word> SecWordBlock;
@@ -493,8 +559,8 @@ typedef SecBlock<word> SecWordBlock;
 NAMESPACE_END
 
 NAMESPACE_BEGIN(std)
-template <class T>
-inline void swap(CryptoPP::SecBlock<T> &a, CryptoPP::SecBlock<T> &b)
+template <class T, class A>
+inline void swap(CryptoPP::SecBlock<T, A> &a, CryptoPP::SecBlock<T, A> &b)
 {
 	a.swap(b);
 }
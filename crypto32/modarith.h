@@ -7,9 +7,73 @@
 #include "misc.h"
 #include "integer.h"
 #include "algebra.h"
+#include "smartptr.h"
 
 NAMESPACE_BEGIN(CryptoPP)
 
+// reduces double-length products modulo a fixed modulus without a long division
+class ModularReducer
+{
+public:
+	virtual ~ModularReducer() {}
+	virtual ModularReducer * Clone() const =0;
+
+	// R[N] --- result = T mod m, where N is the register size of m
+	// T[2*N] - product of two numbers less than m, destroyed
+	// W[6*N] - temporary work space
+	virtual void Reduce(word *R, word *T, word *W, unsigned int N) const =0;
+};
+
+// Barrett reduction, works for any modulus
+class BarrettReducer : public ModularReducer
+{
+public:
+	BarrettReducer(const Integer &modulus);
+	ModularReducer * Clone() const {return new BarrettReducer(*this);}
+	void Reduce(word *R, word *T, word *W, unsigned int N) const;
+
+private:
+	unsigned int shift;
+	SecWordBlock m, mu;
+};
+
+// folding reduction for moduli of the form 2**k - c, with c much smaller than 2**k
+class PseudoMersenneReducer : public ModularReducer
+{
+public:
+	PseudoMersenneReducer(const Integer &modulus);
+	ModularReducer * Clone() const {return new PseudoMersenneReducer(*this);}
+	void Reduce(word *R, word *T, word *W, unsigned int N) const;
+
+	static bool IsPseudoMersenne(const Integer &modulus);
+
+private:
+	unsigned int k;
+	SecWordBlock m, c;
+};
+
+// Solinas reduction for the NIST primes P-192, P-224, P-256 and P-384, with the sums of 32-bit
+// chunks from FIPS 186-2 written out for each prime in fixed-size code
+// (P-521 is a Mersenne prime and is handled by PseudoMersenneReducer)
+class NISTPrimeReducer : public ModularReducer
+{
+public:
+	NISTPrimeReducer(const Integer &modulus);
+	ModularReducer * Clone() const {return new NISTPrimeReducer(*this);}
+	void Reduce(word *R, word *T, word *W, unsigned int N) const;
+
+	static bool IsNISTPrime(const Integer &modulus);
+
+private:
+	unsigned int index;	// which of the primes
+	SecWordBlock m;		// the prime, with room for the carry out of the chunk sums
+};
+
+// Like the other rings and groups, ModularArithmetic returns its results in mutable members,
+// so an object may only be used by one thread at a time, even through const member functions.
+// Threads sharing a modulus should each work with their own copy, see Clone(). This is why the
+// const functions of keys, curves and precomputations, which threads may share, do their
+// arithmetic in a copy of the ModularArithmetic or field they keep.
 class ModularArithmetic : public RingWithDefaultMultiplicativeGroup<Integer>
 {
 public:
@@ -17,14 +81,43 @@ public:
 	typedef int RandomizationParameter;
 	typedef Integer Element ;
 
-	ModularArithmetic(const Integer &modulus = Integer::One())
-		: modulus(modulus), result((word)0, modulus.reg.size) {}
+	class UnsupportedModulus : public Exception
+	{
+	public:
+		UnsupportedModulus() : Exception("ModularArithmetic: modulus does not have a supported special form") {}
+	};
+
+	// how Multiply() and Square() reduce their products, AUTOMATIC picks SPECIAL_FORM if the
+	// modulus has one, otherwise DIVISION, which it changes to BARRETT once an object has done
+	// enough reductions to pay for the setup, so that objects used once don't pay for it
+	enum ReductionMethod {AUTOMATIC, DIVISION, BARRETT, SPECIAL_FORM};
+
+	ModularArithmetic(const Integer &modulus = Integer::One(), ReductionMethod method = AUTOMATIC)
+		: modulus(modulus), result((word)0, modulus.reg.size), workspace(8*modulus.reg.size+6)
+		{SetReducer(method);}
+
+	// reducer must reduce modulo this modulus, it is copied
+	ModularArithmetic(const Integer &modulus, const ModularReducer &reducer)
+		: modulus(modulus), result((word)0, modulus.reg.size), workspace(8*modulus.reg.size+6)
+		, method(SPECIAL_FORM), reducer(reducer.Clone()), divisionsBeforeBarrett(0) {}
 
 	ModularArithmetic(const ModularArithmetic &ma)
-		: modulus(ma.modulus), result((word)0, modulus.reg.size) {}
+		: modulus(ma.modulus), result((word)0, modulus.reg.size), workspace(8*modulus.reg.size+6)
+		, method(ma.method), reducer(ma.reducer.get() ? ma.reducer->Clone() : NULL)
+		, divisionsBeforeBarrett(ma.divisionsBeforeBarrett) {}
+
+	// a copy of the same class, with its own result and workspace members
+	virtual ModularArithmetic * Clone() const {return new ModularArithmetic(*this);}
 
 	const Integer& GetModulus() const {return modulus;}
-	void SetModulus(const Integer &newModulus) {modulus = newModulus; result.reg.Resize(modulus.reg.size);}
+	void SetModulus(const Integer &newModulus, ReductionMethod newMethod = AUTOMATIC)
+		{modulus = newModulus; result.reg.Resize(modulus.reg.size); workspace.New(8*modulus.reg.size+6); SetReducer(newMethod);}
+
+	// never AUTOMATIC, a caller supplied reducer counts as SPECIAL_FORM
+	ReductionMethod GetReductionMethod() const {return method;}
+
+	// returns true if AUTOMATIC picks SPECIAL_FORM for modulus, without setting up a reducer
+	static bool HasSpecialForm(const Integer &modulus);
 
 	virtual Integer ConvertIn(const Integer &a) const
 		{return a%modulus;}
@@ -56,17 +149,18 @@ public:
 	const Integer& One() const
 		{return Integer::One();}
 
-	const Integer& Multiply(const Integer &a, const Integer &b) const
-		{return result1 = a*b%modulus;}
+	const Integer& Multiply(const Integer &a, const Integer &b) const;
 
-	const Integer& Square(const Integer &a) const
-		{return result1 = a.Squared()%modulus;}
+	const Integer& Square(const Integer &a) const;
 
 	virtual bool IsUnit(const Integer &a) const
 		{return Integer::Gcd(a, modulus).IsUnit();}
 
 	const Integer& MultiplicativeInverse(const Integer &a) const;
 
+	// skips the gcd that IsUnit() would cost
+	void BatchInverse(Integer *elements, unsigned int count) const;
+
 	const Integer& Divide(const Integer &a, const Integer &b) const
 		{return Multiply(a, MultiplicativeInverse(b));}
 
@@ -91,7 +185,18 @@ public:
 protected:
 	Integer modulus;
 	mutable Integer result, result1;
+	// products and quotients are formed here instead of in temporary Integers
+	mutable SecWordBlock workspace;
 
+private:
+	void SetReducer(ReductionMethod method);
+	void CountDivision() const;
+	const Integer& ReduceProduct() const;
+
+	// AUTOMATIC replaces DIVISION with BARRETT in const functions
+	mutable ReductionMethod method;
+	mutable member_ptr<ModularReducer> reducer;
+	mutable unsigned int divisionsBeforeBarrett;	// zero unless AUTOMATIC picked DIVISION
 };
 
 // const ModularArithmetic::RandomizationParameter ModularArithmetic::DefaultRandomizationParameter = 0 ;
@@ -101,6 +206,8 @@ class MontgomeryRepresentation : public ModularArithmetic
 {
 public:
 	MontgomeryRepresentation(const Integer &modulus);	// modulus must be odd
+	MontgomeryRepresentation(const MontgomeryRepresentation &mr);
+	ModularArithmetic * Clone() const {return new MontgomeryRepresentation(*this);}
 
 	Integer ConvertIn(const Integer &a) const
 		{return (a<<(WORD_BITS*modulus.reg.size))%modulus;}
@@ -122,9 +229,10 @@ public:
 	Integer CascadeExponentiate(const Integer &x, const Integer &e1, const Integer &y, const Integer &e2) const
 		{return AbstractRing<Integer>::CascadeExponentiate(x, e1, y, e2);}
 
+	Integer FixedWindowExponentiate(const Integer &a, const Integer &e, unsigned int expLen) const;
+
 private:
 	Integer u;
-	SecWordBlock workspace;
 };
 
 NAMESPACE_END
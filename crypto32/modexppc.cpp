@@ -9,6 +9,31 @@
 
 NAMESPACE_BEGIN(CryptoPP)
 
+ANONYMOUS_NAMESPACE_BEGIN
+// the elements are Montgomery representations, one coordinate each
+class ModExpImageCodec
+{
+public:
+	ModExpImageCodec(const Integer &modulus) : modulus(modulus), size(modulus.ByteCount()) {}
+
+	word32 Tag() const {return 1;}
+	unsigned int Coordinates() const {return 1;}
+	unsigned int CoordinateSize() const {return size;}
+	void EncodeModulus(byte *output) const {modulus.Encode(output, size);}
+	void Encode(byte *output, const Integer &a) const {a.Encode(output, size);}
+	void Decode(Integer &a, const byte *input) const
+	{
+		a.Decode(input, size);
+		if (a >= modulus)
+			throw InvalidPrecomputationImage();
+	}
+
+private:
+	const Integer &modulus;
+	unsigned int size;
+};
+NAMESPACE_END
+
 ModExpPrecomputation::~ModExpPrecomputation() {}
 
 ModExpPrecomputation::ModExpPrecomputation(const Integer &mod, const Integer &base, unsigned int maxExpBits, unsigned int storage)
@@ -67,16 +92,33 @@ void ModExpPrecomputation::Save(BufferedTransformation &bt) const
 	seq.InputFinished();
 }
 
+void ModExpPrecomputation::SaveImage(BufferedTransformation &bt) const
+{
+	assert(mr.get() && ep.get());
+	SavePrecomputationImage(bt, *ep, ModExpImageCodec(mr->GetModulus()));
+}
+
+unsigned int ModExpPrecomputation::LoadImage(const Integer &mod, const byte *image, unsigned int length)
+{
+	if (!mr.get() || mr->GetModulus()!=mod)
+		mr.reset(new MontgomeryRepresentation(mod));
+
+	ep.reset(new ExponentiationPrecomputation<Integer>(mr->MultiplicativeGroup()));
+	return LoadPrecomputationImage(*ep, image, length, ModExpImageCodec(mr->GetModulus()));
+}
+
 Integer ModExpPrecomputation::Exponentiate(const Integer &exponent) const
 {
 	assert(mr.get() && ep.get());
-	return mr->ConvertOut(ep->Exponentiate(exponent));
+	MontgomeryRepresentation mr(*this->mr);
+	return mr.ConvertOut(ep->Exponentiate(mr.MultiplicativeGroup(), exponent));
 }
 
 Integer ModExpPrecomputation::CascadeExponentiate(const Integer &exponent, const ModExpPrecomputation &pc2, const Integer &exponent2) const
 {
 	assert(mr.get() && ep.get());
-	return mr->ConvertOut(ep->CascadeExponentiate(exponent, *pc2.ep, exponent2));
+	MontgomeryRepresentation mr(*this->mr);
+	return mr.ConvertOut(ep->CascadeExponentiate(mr.MultiplicativeGroup(), exponent, *pc2.ep, exponent2));
 }
 
 NAMESPACE_END
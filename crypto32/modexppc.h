@@ -20,9 +20,20 @@ public:
 	void Precompute(const Integer &modulus, const Integer &base, unsigned int maxExpBits, unsigned int storage);
 	void Load(const Integer &modulus, BufferedTransformation &storedPrecomputation);
 	void Save(BufferedTransformation &storedPrecomputation) const;
+	// a fixed-layout image of the tables that LoadImage() reads without parsing, for sharing a
+	// precomputation between processes through a file they map read-only into memory
+	void SaveImage(BufferedTransformation &storedPrecomputation) const;
+	// returns the number of bytes of image read, throws InvalidPrecomputationImage if it doesn't fit modulus
+	unsigned int LoadImage(const Integer &modulus, const byte *image, unsigned int length);
 
 	Integer Exponentiate(const Integer &exponent) const;
 	Integer CascadeExponentiate(const Integer &exponent, const ModExpPrecomputation &pc2, const Integer &exponent2) const;
+	// the number of precomputed powers of the base, 0 if there are none yet
+	unsigned int Storage() const {return ep.get() ? ep->storage : 0;}
+
+	// the Montgomery representation of the modulus, for exponentiating other bases, its
+	// results are shared so a thread should work in a copy of it
+	const MontgomeryRepresentation & GetMontgomeryRepresentation() const {assert(mr.get()); return *mr;}
 
 private:
 	member_ptr<MontgomeryRepresentation> mr;
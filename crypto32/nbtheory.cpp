@@ -3,6 +3,7 @@
 #include "pch.h"
 #include "nbtheory.h"
 #include "modarith.h"
+#include "thread.h"
 
 #include <math.h>
 #include <vector>
@@ -12,6 +13,11 @@ NAMESPACE_BEGIN(CryptoPP)
 const unsigned int maxPrimeTableSize = 3511;	// last prime 32719
 const word lastSmallPrime = 32719;
 unsigned int primeTableSize=552;
+static Mutex primeTableMutex;
+// each round of a search tries as many starting points or candidates as there are threads,
+// so that with one thread it costs and uses the rng as it did before the threads were added
+static unsigned int primeSearchThreadCount = 1;
+static const unsigned int maxPrimeSearchThreadCount = 16;
 
 word primeTable[maxPrimeTableSize] =
 	{2, 3, 5, 7, 11, 13, 17, 19,
@@ -86,6 +92,14 @@ word primeTable[maxPrimeTableSize] =
 
 void BuildPrimeTable()
 {
+	// once it is built, the table is only read, so the prime search threads can share it
+	if (primeTableSize == maxPrimeTableSize)
+		return;
+
+	MutexLock lock(primeTableMutex);
+	if (primeTableSize == maxPrimeTableSize)
+		return;
+
 	unsigned int p=primeTable[primeTableSize-1];
 	for (int i=primeTableSize; i<maxPrimeTableSize; i++)
 	{
@@ -289,6 +303,16 @@ unsigned int PrimeSearchInterval(const Integer &max)
 	return max.BitCount();
 }
 
+void SetPrimeSearchThreadCount(unsigned int threadCount)
+{
+	primeSearchThreadCount = STDMAX(1U, STDMIN(threadCount, maxPrimeSearchThreadCount));
+}
+
+unsigned int GetPrimeSearchThreadCount()
+{
+	return primeSearchThreadCount;
+}
+
 static inline bool FastProbablePrimeTest(const Integer &n)
 {
 	return IsStrongProbablePrime(n,2);
@@ -302,90 +326,333 @@ public:
 	bool NextCandidate(Integer &c);
 
 	void DoSieve();
-	static void SieveSingle(std::vector<bool> &sieve, word p, const Integer &first, const Integer &step, word stepInv);
+	void AddPrime(word p, word firstMod, word stepMod, const Integer &first, const Integer &step);
+
+	Integer m_first, m_step, m_remaining;
+	unsigned int m_size, m_next;
+	std::vector<word> m_sieve;		// bit i is set if m_first+i*m_step has a small prime factor
+	std::vector<word> m_primes, m_offsets;	// next multiple of each prime, as an index into the window
+	std::vector<word> m_wheel;		// the sieve for the smallest primes, which repeats every m_wheelSize bits
+	unsigned int m_wheelSize, m_wheelPos;
+};
 
-	Integer m_first, m_last, m_step;
-	signed int m_delta;
-	word m_next;
-	std::vector<bool> m_sieve;
+// shared by the searches of one RunPrimeSearch() call
+struct PrimeSearchProgress
+{
+	PrimeSearchProgress(unsigned int count) : firstFound(count) {}
+
+	Mutex mutex;
+	unsigned int firstFound;	// the first search that has succeeded so far, held under mutex
 };
 
-PrimeSieve::PrimeSieve(const Integer &first, const Integer &last, const Integer &step, signed int delta)
-	: m_first(first), m_last(last), m_step(step), m_delta(delta), m_next(0)
+// one of several searches over disjoint sets of candidates that RunPrimeSearch() runs at the same time
+class PrimeSearchTask : public WorkerTask
 {
-	DoSieve();
+public:
+	PrimeSearchTask() : m_progress(NULL), m_index(0), m_found(false) {}
+
+	void Run()
+	{
+		m_found = !Cancelled() && Search();
+		if (m_found && m_progress)
+		{
+			MutexLock lock(m_progress->mutex);
+			m_progress->firstFound = STDMIN(m_progress->firstFound, m_index);
+		}
+	}
+
+	// returns true if a search that comes earlier in candidate order has already succeeded
+	bool Cancelled() const
+	{
+		if (!m_progress)
+			return false;
+		MutexLock lock(m_progress->mutex);
+		return m_progress->firstFound < m_index;
+	}
+
+	// returns true if a prime was found, may return false early if Cancelled()
+	virtual bool Search() =0;
+
+	PrimeSearchProgress *m_progress;
+	unsigned int m_index;
+	bool m_found;		// read only after RunWorkerTasks() has returned
+};
+
+// runs tasks[first], tasks[first+step], tasks[first+2*step], ... one after another
+class PrimeSearchWorker : public WorkerTask
+{
+public:
+	PrimeSearchWorker(WorkerTask *const *tasks, unsigned int count, unsigned int first, unsigned int step)
+		: m_tasks(tasks), m_count(count), m_first(first), m_step(step) {}
+
+	void Run()
+	{
+		for (unsigned int i=m_first; i<m_count; i+=m_step)
+			m_tasks[i]->Run();
+	}
+
+private:
+	WorkerTask *const *m_tasks;
+	unsigned int m_count, m_first, m_step;
+};
+
+// runs tasks[0..count) on up to primeSearchThreadCount threads, earlier tasks first, and returns
+// the index of the first task that succeeded, or count if none did
+template <class T> static unsigned int RunPrimeSearch(std::vector<T> &tasks)
+{
+	const unsigned int count = tasks.size();
+	const unsigned int threadCount = STDMIN(count, primeSearchThreadCount);
+	PrimeSearchProgress progress(count);
+	std::vector<WorkerTask *> taskPointers(count), workerPointers(threadCount);
+	std::vector<PrimeSearchWorker> workers;
+	unsigned int i;
+
+	BuildPrimeTable();	// before any worker starts, so that they only read the table
+	for (i=0; i<count; i++)
+	{
+		tasks[i].m_progress = &progress;
+		tasks[i].m_index = i;
+		taskPointers[i] = &tasks[i];
+	}
+
+	workers.reserve(threadCount);
+	for (i=0; i<threadCount; i++)
+	{
+		workers.push_back(PrimeSearchWorker(&taskPointers[0], count, i, threadCount));
+		workerPointers[i] = &workers[i];
+	}
+
+	RunWorkerTasks(&workerPointers[0], threadCount);
+
+	for (i=0; i<count; i++)
+		if (tasks[i].m_found)
+			return i;
+	return count;
 }
 
-bool PrimeSieve::NextCandidate(Integer &c)
+// tests the candidates of a PrimeSieve over [first, last] in order
+class SieveSearchTask : public PrimeSearchTask
 {
-	m_next = std::find(m_sieve.begin()+m_next, m_sieve.end(), false) - m_sieve.begin();
-	if (m_next == m_sieve.size())
+public:
+	SieveSearchTask(const Integer &step, signed int delta=0)
+		: step(step), delta(delta) {}
+
+	bool Search()
 	{
-		m_first += m_sieve.size()*m_step;
-		if (m_first > m_last)
-			return false;
-		else
+		PrimeSieve sieve(first, last, step, delta);
+		while (sieve.NextCandidate(p))
 		{
-			m_next = 0;
-			DoSieve();
-			return NextCandidate(c);
+			if (Cancelled())
+				return false;
+			if (Test(p))
+				return true;
 		}
+		return false;
 	}
-	else
+
+	virtual bool Test(const Integer &c) =0;
+
+	Integer first, last, p;
+
+protected:
+	Integer step;
+	signed int delta;
+};
+
+// sets residues[i] = a % primeTable[i], dividing a by products of as many primes as fit in a word
+static void SmallPrimeResidues(std::vector<word> &residues, const Integer &a)
+{
+	residues.resize(primeTableSize);
+	unsigned int i = 0;
+	while (i < primeTableSize)
 	{
-		c = m_first + m_next*m_step;
-		++m_next;
-		return true;
+		word product = primeTable[i];
+		unsigned int j = i+1;
+		while (j < primeTableSize && product <= ~word(0) / primeTable[j])
+			product *= primeTable[j++];
+
+		word r = a % product;
+		for (; i<j; i++)
+			residues[i] = r % primeTable[i];
 	}
 }
 
-void PrimeSieve::SieveSingle(std::vector<bool> &sieve, word p, const Integer &first, const Integer &step, word stepInv)
+// returns the inverse of a mod p, or 0 if there isn't one
+static word InverseModSmallPrime(word a, word p)
 {
-	if (stepInv)
+	word g0 = p, g1 = a;
+	word v0 = 0, v1 = 1;
+	word y;
+
+	while (g1)
 	{
-		unsigned int sieveSize = sieve.size();
-		word j = word((dword(p-(first%p))*stepInv) % p);
-		// if the first multiple of p is p, skip it
-		if (first.WordCount() <= 1 && first + step*j == p)
-			j += p;
-		for (; j < sieveSize; j += p)
-			sieve[j] = true;
+		if (g1 == 1)
+			return v1;
+		y = g0 / g1;
+		g0 = g0 % g1;
+		v0 += y * v1;
+
+		if (!g0)
+			break;
+		if (g0 == 1)
+			return p-v0;
+		y = g1 / g0;
+		g1 = g1 % g0;
+		v1 += y * v0;
 	}
+	return 0;
 }
 
-void PrimeSieve::DoSieve()
+// the sieve is a bitmap of this many candidates, 8K bytes so it stays in the L1 cache
+static const unsigned int maxSieveSize = 65536;
+// the wheel covers small primes whose product is at most this
+static const word maxWheelSize = 2*3*5*7*11*13;
+
+PrimeSieve::PrimeSieve(const Integer &first, const Integer &last, const Integer &step, signed int delta)
+	: m_first(first), m_step(step), m_remaining(first > last ? Integer::Zero() : (last-first)/step+1), m_size(0), m_next(0), m_wheelSize(1), m_wheelPos(0)
 {
 	BuildPrimeTable();
 
-	const unsigned int maxSieveSize = 32768;
-	unsigned int sieveSize = STDMIN(Integer(maxSieveSize), (m_last-m_first)/m_step+1).ConvertToLong();
+	std::vector<word> firstResidues, stepResidues;
+	SmallPrimeResidues(firstResidues, first);
+	SmallPrimeResidues(stepResidues, step);
 
-	m_sieve.clear();
-	m_sieve.resize(sieveSize, false);
+	// the offsets are computed from the residues once, and then carried from window to window
+	m_primes.reserve(delta ? 2*primeTableSize : primeTableSize);
+	m_offsets.reserve(m_primes.capacity());
 
-	if (m_delta == 0)
+	Integer qFirst, halfStep;
+	std::vector<word> qFirstResidues, halfStepResidues;
+	if (delta != 0)
 	{
-		for (unsigned int i = 0; i < primeTableSize; ++i)
-			SieveSingle(m_sieve, primeTable[i], m_first, m_step, m_step.InverseMod(primeTable[i]));
+		assert(m_step%2==0);
+		qFirst = (m_first-delta) >> 1;
+		halfStep = m_step >> 1;
+		SmallPrimeResidues(qFirstResidues, qFirst);
+		SmallPrimeResidues(halfStepResidues, halfStep);
 	}
-	else
+
+	for (unsigned int i = 0; i < primeTableSize; ++i)
 	{
-		assert(m_step%2==0);
-		Integer qFirst = (m_first-m_delta) >> 1;
-		Integer halfStep = m_step >> 1;
-		for (unsigned int i = 0; i < primeTableSize; ++i)
+		AddPrime(primeTable[i], firstResidues[i], stepResidues[i], first, step);
+		if (delta != 0)
+			AddPrime(primeTable[i], qFirstResidues[i], halfStepResidues[i], qFirst, halfStep);
+	}
+
+	// stamp a repeating pattern for the smallest primes instead of marking their multiples,
+	// the entries for one prime (two of them in a double sieve) go into the wheel together
+	unsigned int wheelPrimes = 0;
+	while (wheelPrimes < m_primes.size())
+	{
+		const word p = m_primes[wheelPrimes];
+		unsigned int end = wheelPrimes;
+		bool periodic = true;
+		while (end < m_primes.size() && m_primes[end] == p)
+			periodic = periodic && m_offsets[end++] < p;
+		if (!periodic || m_wheelSize * p > maxWheelSize)
+			break;
+		m_wheelSize *= p;
+		wheelPrimes = end;
+	}
+
+	if (wheelPrimes > 0)
+	{
+		const unsigned int patternSize = m_wheelSize + WORD_BITS;
+		m_wheel.resize(bitsToWords(patternSize) + 1, 0);
+		for (unsigned int k = 0; k < wheelPrimes; k++)
+			for (word j = m_offsets[k]; j < patternSize; j += m_primes[k])
+				m_wheel[j/WORD_BITS] |= word(1) << (j%WORD_BITS);
+
+		m_primes.erase(m_primes.begin(), m_primes.begin()+wheelPrimes);
+		m_offsets.erase(m_offsets.begin(), m_offsets.begin()+wheelPrimes);
+	}
+
+	DoSieve();
+}
+
+void PrimeSieve::AddPrime(word p, word firstMod, word stepMod, const Integer &first, const Integer &step)
+{
+	word stepInv = InverseModSmallPrime(stepMod, p);
+	if (!stepInv)
+		return;		// p divides step, so it divides all or none of the candidates
+
+	word j = word(dword(firstMod ? p-firstMod : 0) * stepInv % p);
+	// if the first multiple of p is p, skip it
+	if (first.WordCount() <= 1 && first <= Integer(p) && first + step*j == p)
+		j += p;
+
+	m_primes.push_back(p);
+	m_offsets.push_back(j);
+}
+
+bool PrimeSieve::NextCandidate(Integer &c)
+{
+	while (true)
+	{
+		while (m_next < m_size)
 		{
-			word p = primeTable[i];
-			word stepInv = m_step.InverseMod(p);
-			SieveSingle(m_sieve, p, m_first, m_step, stepInv);
+			word w = ~m_sieve[m_next/WORD_BITS] >> (m_next%WORD_BITS);
+			if (!w)
+			{
+				m_next = (m_next/WORD_BITS + 1) * WORD_BITS;
+				continue;
+			}
+
+			while (!(w & 1))
+			{
+				w >>= 1;
+				m_next++;
+			}
+			if (m_next >= m_size)
+				break;
 
-			word halfStepInv = 2*stepInv < p ? 2*stepInv : 2*stepInv-p;
-			SieveSingle(m_sieve, p, qFirst, halfStep, halfStepInv);
+			c = m_first + m_next*m_step;
+			++m_next;
+			return true;
 		}
+
+		m_first += m_size*m_step;
+		m_next = 0;
+		if (!m_remaining)
+			return false;
+		DoSieve();
 	}
 }
 
-bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Integer &mod)
+void PrimeSieve::DoSieve()
+{
+	m_size = STDMIN(Integer(maxSieveSize), m_remaining).ConvertToLong();
+	m_remaining -= m_size;
+
+	const unsigned int sieveWords = bitsToWords(m_size);
+	m_sieve.resize(sieveWords);
+
+	if (m_wheel.empty())
+		std::fill(m_sieve.begin(), m_sieve.end(), word(0));
+	else
+	{
+		unsigned int pos = m_wheelPos;
+		for (unsigned int i = 0; i < sieveWords; i++)
+		{
+			const unsigned int shift = pos%WORD_BITS;
+			const word *w = &m_wheel[pos/WORD_BITS];
+			m_sieve[i] = shift ? (w[0] >> shift) | (w[1] << (WORD_BITS-shift)) : w[0];
+			pos = (pos + WORD_BITS) % m_wheelSize;
+		}
+		m_wheelPos = (m_wheelPos + m_size) % m_wheelSize;
+	}
+
+	for (unsigned int k = 0; k < m_primes.size(); ++k)
+	{
+		const word p = m_primes[k];
+		word j = m_offsets[k];
+		for (; j < m_size; j += p)
+			m_sieve[j/WORD_BITS] |= word(1) << (j%WORD_BITS);
+		m_offsets[k] = j - m_size;
+	}
+}
+
+static bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Integer &mod, const PrimeSearchTask *task)
 {
 	assert(!equiv.IsNegative() && equiv < mod);
 
@@ -429,7 +696,7 @@ bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Inte
 	assert(p > primeTable[primeTableSize-1]);
 
 	if (mod.IsOdd())
-		return FirstPrime(p, max, CRT(equiv, mod, 1, 2, 1), mod<<1);
+		return FirstPrime(p, max, CRT(equiv, mod, 1, 2, 1), mod<<1, task);
 
 	p += (equiv-p)%mod;
 
@@ -440,6 +707,8 @@ bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Inte
 
 	while (sieve.NextCandidate(p))
 	{
+		if (task && task->Cancelled())
+			return false;
 		if (FastProbablePrimeTest(p) && IsPrime(p))
 			return true;
 	}
@@ -447,6 +716,42 @@ bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Inte
 	return false;
 }
 
+bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Integer &mod)
+{
+	return FirstPrime(p, max, equiv, mod, NULL);
+}
+
+class FirstPrimeTask : public PrimeSearchTask
+{
+public:
+	FirstPrimeTask(const Integer &equiv, const Integer &mod)
+		: equiv(equiv), mod(mod) {}
+
+	bool Search()
+		{return FirstPrime(p, max, equiv, mod, this);}
+
+	Integer p, max;
+
+private:
+	Integer equiv, mod;
+};
+
+bool RandomPrimeSearch(Integer &p, RandomNumberGenerator &rng, const Integer &min, const Integer &max, const Integer &equiv, const Integer &mod)
+{
+	std::vector<FirstPrimeTask> tasks(primeSearchThreadCount, FirstPrimeTask(equiv, mod));
+	for (unsigned int i=0; i<tasks.size(); i++)
+	{
+		tasks[i].p.Randomize(rng, min, max);
+		tasks[i].max = STDMIN(tasks[i].p+mod*PrimeSearchInterval(max), max);
+	}
+
+	unsigned int found = RunPrimeSearch(tasks);
+	if (found == tasks.size())
+		return false;
+	p = tasks[found].p;
+	return true;
+}
+
 // the following two functions are based on code and comments provided by Preda Mihailescu
 static bool ProvePrime(const Integer &p, const Integer &q)
 {
@@ -472,6 +777,19 @@ static bool ProvePrime(const Integer &p, const Integer &q)
 	return false;
 }
 
+class MihailescuPrimeTask : public SieveSearchTask
+{
+public:
+	MihailescuPrimeTask(const Integer &q)
+		: SieveSearchTask(q<<1), q(q) {}
+
+	bool Test(const Integer &c)
+		{return FastProbablePrimeTest(c) && ProvePrime(c, q);}
+
+private:
+	Integer q;
+};
+
 Integer MihailescuProvablePrime(RandomNumberGenerator &rng, unsigned int pbits)
 {
 	Integer p;
@@ -488,30 +806,51 @@ Integer MihailescuProvablePrime(RandomNumberGenerator &rng, unsigned int pbits)
 	unsigned int qbits = (pbits+2)/3 + 1 + rng.GetLong(0, pbits/36);
 	Integer q = MihailescuProvablePrime(rng, qbits);
 	Integer q2 = q<<1;
+	std::vector<MihailescuPrimeTask> tasks(primeSearchThreadCount, MihailescuPrimeTask(q));
 
 	while (true)
 	{
-		// this initializes the sieve to search in the arithmetic
+		// this initializes the sieves to search in the arithmetic
 		// progression p = p_0 + \lambda * q2 = p_0 + 2 * \lambda * q,
 		// with q the recursively generated prime above. We will be able
 		// to use Lucas tets for proving primality. A trick of Quisquater
 		// allows taking q > cubic_root(p) rather then square_root: this
 		// decreases the recursion.
 
-		p.Randomize(rng, minP, maxP, Integer::ANY, 1, q2);
-		PrimeSieve sieve(p, STDMIN(p+PrimeSearchInterval(maxP)*q2, maxP), q2);
-
-		while (sieve.NextCandidate(p))
+		for (unsigned int i=0; i<tasks.size(); i++)
 		{
-			if (FastProbablePrimeTest(p) && ProvePrime(p, q))
-				return p;
+			tasks[i].first.Randomize(rng, minP, maxP, Integer::ANY, 1, q2);
+			tasks[i].last = STDMIN(tasks[i].first+PrimeSearchInterval(maxP)*q2, maxP);
 		}
+
+		unsigned int found = RunPrimeSearch(tasks);
+		if (found < tasks.size())
+			return tasks[found].p;
 	}
 
 	// not reached
 	return p;
 }
 
+// tests a candidate p = 2*r*q+1 that has passed trial division, with the base a
+class MaurerPrimeTask : public PrimeSearchTask
+{
+public:
+	MaurerPrimeTask(const Integer &q)
+		: q(q) {}
+
+	bool Search()
+	{
+		Integer b = a_exp_b_mod_c(a, (p-1)/q, p);
+		return (GCD(b-1, p) == 1) && (a_exp_b_mod_c(b, q, p) == 1);
+	}
+
+	Integer p, a;
+
+private:
+	Integer q;
+};
+
 Integer MaurerProvablePrime(RandomNumberGenerator &rng, unsigned int bits)
 {
 	const unsigned smallPrimeBound = 29, c_opt=10;
@@ -532,23 +871,29 @@ Integer MaurerProvablePrime(RandomNumberGenerator &rng, unsigned int bits)
 			relativeSize = pow(2.0, double(rng.GetLong())/0xffffffff - 1);
 		while (bits * relativeSize >= bits - margin);
 
-		Integer a,b;
 		Integer q = MaurerProvablePrime(rng, unsigned(bits*relativeSize));
 		Integer I = Integer::Power2(bits-2)/q;
 		Integer I2 = I << 1;
 		unsigned int trialDivisorBound = (unsigned int)STDMIN((unsigned long)primeTable[primeTableSize-1], (unsigned long)bits*bits/c_opt);
-		bool success = false;
-		while (!success)
+		std::vector<MaurerPrimeTask> tasks(primeSearchThreadCount, MaurerPrimeTask(q));
+		unsigned int found = tasks.size();
+		while (found == tasks.size())
 		{
-			p.Randomize(rng, I, I2, Integer::ANY);
-			p *= q; p <<= 1; ++p;
-			if (!TrialDivision(p, trialDivisorBound))
+			// trial division is cheap, so it's done here, and a base is drawn only for a survivor
+			for (unsigned int i=0; i<tasks.size(); i++)
 			{
-				a.Randomize(rng, 2, p-1, Integer::ANY);
-				b = a_exp_b_mod_c(a, (p-1)/q, p);
-				success = (GCD(b-1, p) == 1) && (a_exp_b_mod_c(b, q, p) == 1);
+				do
+				{
+					p.Randomize(rng, I, I2, Integer::ANY);
+					p *= q; p <<= 1; ++p;
+				}
+				while (TrialDivision(p, trialDivisorBound));
+				tasks[i].p = p;
+				tasks[i].a.Randomize(rng, 2, p-1, Integer::ANY);
 			}
+			found = RunPrimeSearch(tasks);
 		}
+		p = tasks[found].p;
 	}
 	return p;
 }
@@ -613,6 +958,23 @@ Integer ModularSquareRoot(const Integer &a, const Integer &p)
 	return x;
 }
 
+int ModularSquareRootAndJacobi(Integer &x, const Integer &a, const Integer &e, const MontgomeryRepresentation &mr)
+{
+	const Integer &p = mr.GetModulus();
+	assert(p%4 == 3 && e == (p-3)/4);
+
+	// t = a**((p-3)/4), so t*a is a**((p+1)/4) and t*t*a is a**((p-1)/2), Euler's criterion
+	Integer am = mr.ConvertIn(a);
+	Integer t = mr.FixedWindowExponentiate(am, e, p.BitCount());
+	Integer xm = mr.Multiply(t, am);
+	Integer symbol = mr.ConvertOut(mr.Multiply(t, xm));
+	x = mr.ConvertOut(xm);
+
+	if (!symbol)
+		return 0;
+	return symbol == Integer::One() ? 1 : -1;
+}
+
 Integer ModularRoot(const Integer &a, const Integer &dp, const Integer &dq,
 					const Integer &p, const Integer &q, const Integer &u)
 {
@@ -621,6 +983,20 @@ Integer ModularRoot(const Integer &a, const Integer &dp, const Integer &dq,
 	return CRT(p2, p, q2, q, u);
 }
 
+Integer ModularExponentiation(const Integer &a, const Integer &e, const MontgomeryRepresentation &mr)
+{
+	return mr.ConvertOut(mr.Exponentiate(mr.ConvertIn(a), e));
+}
+
+Integer ModularRoot(const Integer &a, const Integer &dp, const Integer &dq,
+					const MontgomeryRepresentation &pmr, const MontgomeryRepresentation &qmr, const Integer &u)
+{
+	const Integer &p = pmr.GetModulus(), &q = qmr.GetModulus();
+	Integer p2 = pmr.ConvertOut(pmr.FixedWindowExponentiate(pmr.ConvertIn(a), dp, p.BitCount()));
+	Integer q2 = qmr.ConvertOut(qmr.FixedWindowExponentiate(qmr.ConvertIn(a), dq, q.BitCount()));
+	return CRT(p2, p, q2, q, u);
+}
+
 Integer ModularRoot(const Integer &a, const Integer &e,
 					const Integer &p, const Integer &q)
 {
@@ -772,14 +1148,23 @@ int Jacobi(const Integer &aIn, const Integer &bIn)
 	return (b==1) ? result : 0;
 }
 
-Integer Lucas(const Integer &e, const Integer &pIn, const Integer &n)
+Integer Lucas(const Integer &e, const Integer &p, const Integer &n)
+{
+	if (!e)
+		return 2;
+
+	MontgomeryRepresentation m(n);
+	return Lucas(e, p, m);
+}
+
+Integer Lucas(const Integer &e, const Integer &pIn, const MontgomeryRepresentation &m)
 {
 	unsigned i = e.BitCount();
 	if (i==0)
 		return 2;
 
-	MontgomeryRepresentation m(n);
-	Integer p=m.ConvertIn(pIn%n), two=m.ConvertIn(2);
+	const Integer &n = m.GetModulus();
+	Integer p=m.ConvertIn(pIn%n), two=m.Add(m.One(), m.One());
 	Integer v=p, v1=m.Subtract(m.Square(p), two);
 
 	i--;
@@ -990,6 +1375,23 @@ unsigned int DiscreteLogWorkFactor(unsigned int n)
 
 // generate a random prime p of the form 2*q+delta, where delta is 1 or -1 and q is also prime
 // warning: this is takes some time
+class SafePrimeTask : public SieveSearchTask
+{
+public:
+	SafePrimeTask(signed int delta)
+		: SieveSearchTask(12, delta) {}
+
+	bool Test(const Integer &c)
+	{
+		assert(IsSmallPrime(c) || SmallDivisorsTest(c));
+		q = (c-delta) >> 1;
+		assert(IsSmallPrime(q) || SmallDivisorsTest(q));
+		return FastProbablePrimeTest(q) && FastProbablePrimeTest(c) && IsPrime(q) && IsPrime(c);
+	}
+
+	Integer q;
+};
+
 PrimeAndGenerator::PrimeAndGenerator(signed int delta, RandomNumberGenerator &rng, unsigned int pbits)
 {
 	// no prime exists for delta = -1 and pbits = 5
@@ -997,26 +1399,22 @@ PrimeAndGenerator::PrimeAndGenerator(signed int delta, RandomNumberGenerator &rn
 
 	Integer minP = Integer::Power2(pbits-1);
 	Integer maxP = Integer::Power2(pbits) - 1;
-	bool success = false;
+	std::vector<SafePrimeTask> tasks(primeSearchThreadCount, SafePrimeTask(delta));
+	unsigned int found = tasks.size();
 
-	while (!success)
+	while (found == tasks.size())
 	{
-		p.Randomize(rng, minP, maxP, Integer::ANY, 6+5*delta, 12);
-		PrimeSieve sieve(p, STDMIN(p+PrimeSearchInterval(maxP)*12, maxP), 12, delta);
-
-		while (sieve.NextCandidate(p))
+		for (unsigned int i=0; i<tasks.size(); i++)
 		{
-			assert(IsSmallPrime(p) || SmallDivisorsTest(p));
-			q = (p-delta) >> 1;
-			assert(IsSmallPrime(q) || SmallDivisorsTest(q));
-			if (FastProbablePrimeTest(q) && FastProbablePrimeTest(p) && IsPrime(q) && IsPrime(p))
-			{
-				success = true;
-				break;
-			}
+			tasks[i].first.Randomize(rng, minP, maxP, Integer::ANY, 6+5*delta, 12);
+			tasks[i].last = STDMIN(tasks[i].first+PrimeSearchInterval(maxP)*12, maxP);
 		}
+		found = RunPrimeSearch(tasks);
 	}
 
+	p = tasks[found].p;
+	q = tasks[found].q;
+
 	if (delta == 1)
 	{
 		// find g such that g is a quadratic residue mod p, then g has order q
@@ -7,6 +7,8 @@
 
 NAMESPACE_BEGIN(CryptoPP)
 
+class MontgomeryRepresentation;
+
 // export a table of small primes
 extern const unsigned int maxPrimeTableSize;
 extern const word lastSmallPrime;
@@ -54,6 +56,17 @@ bool FirstPrime(Integer &p, const Integer &max, const Integer &equiv, const Inte
 
 unsigned int PrimeSearchInterval(const Integer &max);
 
+// picks a random starting point in [min, max] for each prime search thread, and searches the
+// PrimeSearchInterval() after each for the first probable prime x with x%mod==equiv, returns
+// true and sets p to the prime found after the earliest starting point that has one
+bool RandomPrimeSearch(Integer &p, RandomNumberGenerator &rng, const Integer &min, const Integer &max, const Integer &equiv, const Integer &mod);
+
+// number of threads that Integer::Randomize(), MaurerProvablePrime(), MihailescuProvablePrime()
+// and PrimeAndGenerator use to search for primes, 1 by default, this is a global setting and
+// at most 16 are used, more threads draw more candidates from the rng, so the primes differ
+void SetPrimeSearchThreadCount(unsigned int threadCount);
+unsigned int GetPrimeSearchThreadCount();
+
 // ********** other number theoretic functions ************
 
 inline Integer GCD(const Integer &a, const Integer &b) 
@@ -74,6 +87,8 @@ int Jacobi(const Integer &a, const Integer &b);
 
 // calculates the Lucas function V_e(p, 1) mod n
 Integer Lucas(const Integer &e, const Integer &p, const Integer &n);
+// use this one if a Montgomery representation of n has been precalculated
+Integer Lucas(const Integer &e, const Integer &p, const MontgomeryRepresentation &mr);
 // calculates x such that m==Lucas(e, x, p*q), p q primes
 Integer InverseLucas(const Integer &e, const Integer &m, const Integer &p, const Integer &q);
 // use this one if u=inverse of p mod q has been precalculated
@@ -81,14 +96,22 @@ Integer InverseLucas(const Integer &e, const Integer &m, const Integer &p, const
 
 inline Integer ModularExponentiation(const Integer &a, const Integer &e, const Integer &m)
 	{return a_exp_b_mod_c(a, e, m);}
+// use this one if a Montgomery representation of the modulus has been precalculated
+Integer ModularExponentiation(const Integer &a, const Integer &e, const MontgomeryRepresentation &mr);
 // returns x such that x*x%p == a, p prime
 Integer ModularSquareRoot(const Integer &a, const Integer &p);
+// for a prime p congruent to 3 mod 4, with e=(p-3)/4 and a Montgomery representation of p
+// precalculated, sets x = a**((p+1)/4) mod p, which is a square root of a if there is one,
+// and returns Jacobi(a, p), using a single exponentiation for both
+int ModularSquareRootAndJacobi(Integer &x, const Integer &a, const Integer &e, const MontgomeryRepresentation &mr);
 // returns x such that a==ModularExponentiation(x, e, p*q), p q primes,
 // and e relatively prime to (p-1)*(q-1)
 Integer ModularRoot(const Integer &a, const Integer &e, const Integer &p, const Integer &q);
 // use this one if dp=d%(p-1), dq=d%(q-1), (d is inverse of e mod (p-1)*(q-1))
 // and u=inverse of p mod q have been precalculated
 Integer ModularRoot(const Integer &a, const Integer &dp, const Integer &dq, const Integer &p, const Integer &q, const Integer &u);
+// use this one if Montgomery representations of p and q have also been precalculated
+Integer ModularRoot(const Integer &a, const Integer &dp, const Integer &dq, const MontgomeryRepresentation &pmr, const MontgomeryRepresentation &qmr, const Integer &u);
 
 // returns log base 2 of estimated number of operations to calculate discrete log or factor a number
 unsigned int DiscreteLogWorkFactor(unsigned int bitlength);
@@ -32,6 +32,18 @@ void NRDigestVerifier::SavePrecomputation(BufferedTransformation &bt) const
 	m_ypc.Save(bt);
 }
 
+void NRDigestVerifier::SavePrecomputationImage(BufferedTransformation &bt) const
+{
+	m_gpc.SaveImage(bt);
+	m_ypc.SaveImage(bt);
+}
+
+unsigned int NRDigestVerifier::LoadPrecomputationImage(const byte *image, unsigned int length)
+{
+	unsigned int read = m_gpc.LoadImage(m_p, image, length);
+	return read + m_ypc.LoadImage(m_p, image+read, length-read);
+}
+
 Integer NRDigestVerifier::EncodeDigest(const byte *digest, unsigned int digestLen) const
 {
 	Integer h;
@@ -94,6 +106,34 @@ bool NRDigestVerifier::RawVerify(const Integer &m, const Integer &r, const Integ
 	return r == (m_gpc.CascadeExponentiate(s, m_ypc, r) + m) % m_q;
 }
 
+bool NRDigestVerifier::VerifyDigests(unsigned int count, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid) const
+{
+	const ModExpPrecomputation *gpc = &m_gpc, *ypc = &m_ypc;
+	ModExpPrecomputation gpcBatch, ypcBatch;
+	if (BatchPrecomputationPays(count, STDMIN(m_gpc.Storage(), m_ypc.Storage())))
+	{
+		gpcBatch = m_gpc;
+		ypcBatch = m_ypc;
+		gpcBatch.Precompute(m_p, m_g, ExponentBitLength(), BATCH_PRECOMPUTATION_STORAGE);
+		ypcBatch.Precompute(m_p, m_y, ExponentBitLength(), BATCH_PRECOMPUTATION_STORAGE);
+		gpc = &gpcBatch;
+		ypc = &ypcBatch;
+	}
+
+	unsigned int qLen = m_q.ByteCount();
+	bool pass = true;
+
+	for (unsigned int i=0; i<count; i++)
+	{
+		Integer r(signatures[i], qLen);
+		Integer s(signatures[i]+qLen, qLen);
+		valid[i] = r<m_q && r>=1 && s<m_q
+			&& r == (gpc->CascadeExponentiate(s, *ypc, r) + EncodeDigest(digests[i], digestLens[i])) % m_q;
+		pass = pass && valid[i];
+	}
+	return pass;
+}
+
 // ******************************************************************
 
 NRDigestSigner::NRDigestSigner(const Integer &p, const Integer &q, const Integer &g, const Integer &y, const Integer &x)
@@ -157,7 +197,8 @@ void NRDigestSigner::SignDigest(RandomNumberGenerator &rng, const byte *digest,
 	Integer r;
 	Integer s;
 
-	RawSign(rng, h, r, s);
+	if (!m_noncePool.Sign(m_x, h, r, s))	// the pool was empty, or another k is needed
+		RawSign(rng, h, r, s);
 	unsigned int qLen = m_q.ByteCount();
 	r.Encode(signature, qLen);
 	s.Encode(signature+qLen, qLen);
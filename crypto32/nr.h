@@ -3,6 +3,7 @@
 
 #include "pubkey.h"
 #include "modexppc.h"
+#include "pool.h"
 
 #include <limits.h>
 
@@ -17,9 +18,16 @@ public:
 	void Precompute(unsigned int precomputationStorage=16);
 	void LoadPrecomputation(BufferedTransformation &storedPrecomputation);
 	void SavePrecomputation(BufferedTransformation &storedPrecomputation) const;
+	// the precomputation as fixed-layout images, for sharing it between processes through a file
+	// they map read-only, see ModExpPrecomputation::SaveImage(), returns the number of bytes read
+	void SavePrecomputationImage(BufferedTransformation &storedPrecomputation) const;
+	unsigned int LoadPrecomputationImage(const byte *image, unsigned int length);
 
 	void DEREncode(BufferedTransformation &bt) const;
 	bool VerifyDigest(const byte *digest, unsigned int digestLen, const byte *signature) const;
+	// verifies count signatures under this key, using larger precomputation tables
+	// when enough signatures pay for them, see BatchPrecomputationPays()
+	bool VerifyDigests(unsigned int count, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid) const;
 
 	unsigned int MaxDigestLength() const {return UINT_MAX;}
 	unsigned int DigestSignatureLength() const {return 2*m_q.ByteCount();}
@@ -50,12 +58,19 @@ public:
 	void DEREncode(BufferedTransformation &bt) const;
 	void SignDigest(RandomNumberGenerator &rng, const byte *digest, unsigned int digestLen, byte *signature) const;
 
+	// offline/online signing, as in GDSADigestSigner, the pool keeps nonces k with g^k mod p mod q
+	void StartNoncePool(RandomNumberGenerator *rng, unsigned int capacity=64)
+		{m_noncePool.Start(rng, m_gpc, m_q, false, capacity);}
+	void StopNoncePool() {m_noncePool.Stop();}
+	PrecomputedPoolStatistics GetNoncePoolStatistics() const {return m_noncePool.GetStatistics();}
+
 	const Integer & GetPrivateExponent() const {return m_x;}
 
 protected:
 	void RawSign(RandomNumberGenerator &rng, const Integer &m, Integer &a, Integer &b) const;
 
 	Integer m_x;
+	SigningNoncePool<ModExpPrecomputation> m_noncePool;
 };
 
 template <class H>
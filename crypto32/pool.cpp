@@ -0,0 +1,78 @@
+// pool.cpp - written and placed in the public domain by Wei Dai
+
+#include "pch.h"
+#include "pool.h"
+
+NAMESPACE_BEGIN(CryptoPP)
+
+class SimpleKeyPairGenerator : public KeyPairPool::Generator
+{
+public:
+	SimpleKeyPairGenerator(const PK_SimpleKeyAgreementDomain &domain, RandomNumberGenerator *rng)
+		: m_domain(domain), m_rng(rng) {}
+
+	void Generate(AgreementKeyPair &pair)
+	{
+		pair.privateKey.Resize(m_domain.PrivateKeyLength());
+		pair.publicKey.Resize(m_domain.PublicKeyLength());
+		m_domain.GenerateKeyPair(*m_rng, pair.privateKey, pair.publicKey);
+	}
+
+private:
+	const PK_SimpleKeyAgreementDomain &m_domain;
+	member_ptr<RandomNumberGenerator> m_rng;
+};
+
+PooledSimpleKeyAgreementDomain::PooledSimpleKeyAgreementDomain(const PK_SimpleKeyAgreementDomain &domain, RandomNumberGenerator *rng, unsigned int capacity)
+	: m_domain(domain), m_pool(new SimpleKeyPairGenerator(domain, rng), capacity, capacity/2)
+{
+}
+
+void PooledSimpleKeyAgreementDomain::GenerateKeyPair(RandomNumberGenerator &rng, byte *privateKey, byte *publicKey) const
+{
+	AgreementKeyPair pair;
+	if (m_pool.Take(pair))
+	{
+		memcpy(privateKey, pair.privateKey, pair.privateKey.size);
+		memcpy(publicKey, pair.publicKey, pair.publicKey.size);
+	}
+	else
+		m_domain.GenerateKeyPair(rng, privateKey, publicKey);
+}
+
+class EphemeralKeyPairGenerator : public KeyPairPool::Generator
+{
+public:
+	EphemeralKeyPairGenerator(const PK_AuthenticatedKeyAgreementDomain &domain, RandomNumberGenerator *rng)
+		: m_domain(domain), m_rng(rng) {}
+
+	void Generate(AgreementKeyPair &pair)
+	{
+		pair.privateKey.Resize(m_domain.EphemeralPrivateKeyLength());
+		pair.publicKey.Resize(m_domain.EphemeralPublicKeyLength());
+		m_domain.GenerateEphemeralKeyPair(*m_rng, pair.privateKey, pair.publicKey);
+	}
+
+private:
+	const PK_AuthenticatedKeyAgreementDomain &m_domain;
+	member_ptr<RandomNumberGenerator> m_rng;
+};
+
+PooledAuthenticatedKeyAgreementDomain::PooledAuthenticatedKeyAgreementDomain(const PK_AuthenticatedKeyAgreementDomain &domain, RandomNumberGenerator *rng, unsigned int capacity)
+	: m_domain(domain), m_pool(new EphemeralKeyPairGenerator(domain, rng), capacity, capacity/2)
+{
+}
+
+void PooledAuthenticatedKeyAgreementDomain::GenerateEphemeralKeyPair(RandomNumberGenerator &rng, byte *privateKey, byte *publicKey) const
+{
+	AgreementKeyPair pair;
+	if (m_pool.Take(pair))
+	{
+		memcpy(privateKey, pair.privateKey, pair.privateKey.size);
+		memcpy(publicKey, pair.publicKey, pair.publicKey.size);
+	}
+	else
+		m_domain.GenerateEphemeralKeyPair(rng, privateKey, publicKey);
+}
+
+NAMESPACE_END
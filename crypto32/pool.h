@@ -0,0 +1,366 @@
+#ifndef CRYPTOPP_POOL_H
+#define CRYPTOPP_POOL_H
+
+#include "integer.h"
+#include "modexppc.h"
+#include "nbtheory.h"
+#include "smartptr.h"
+#include "thread.h"
+
+#include <deque>
+
+NAMESPACE_BEGIN(CryptoPP)
+
+// the state of a PrecomputedPool, the counts are since it was created
+struct PrecomputedPoolStatistics
+{
+	PrecomputedPoolStatistics()
+		: size(0), capacity(0), taken(0), missed(0), generated(0), refills(0) {}
+
+	unsigned int size, capacity;	// values ready now, and the most kept
+	unsigned long taken;		// values handed out by Take()
+	unsigned long missed;		// calls to Take() that found the pool empty
+	unsigned long generated;	// values generated, by Fill() or a refill
+	unsigned long refills;		// refill threads started
+};
+
+// a bounded pool of values generated ahead of time, for work that doesn't depend on
+// the input it will be used with, such as signature nonces and ephemeral keys
+/* Take() hands each value out once, and starts a WorkerThread to refill the pool
+   when it has no more than refillLevel values left.  A value is destroyed as soon
+   as it is taken, so values that keep their secrets in SecBlocks are wiped then,
+   or when the pool is destroyed.  All functions may be called from several threads
+   at once.  If THREADS_AVAILABLE isn't defined, only Fill() refills the pool.
+*/
+template <class T> class PrecomputedPool
+{
+public:
+	class Generator
+	{
+	public:
+		virtual ~Generator() {}
+		// called on a refill thread or in Fill(), one call at a time
+		virtual void Generate(T &value) =0;
+	};
+
+	// takes ownership of generator, and starts filling the pool
+	PrecomputedPool(Generator *generator, unsigned int capacity, unsigned int refillLevel);
+	// waits for the refill thread to finish the value it is generating
+	~PrecomputedPool();
+
+	// returns false, counting a miss, if the pool is empty
+	bool Take(T &value);
+	// generates values on the calling thread until the pool is full
+	void Fill();
+	PrecomputedPoolStatistics GetStatistics() const;
+
+	unsigned int m_referenceCount;	// for counted_ptr
+
+private:
+	PrecomputedPool(const PrecomputedPool<T> &);	// not copyable
+	void operator=(const PrecomputedPool<T> &);
+
+	class RefillTask;
+	friend class RefillTask;
+	class RefillTask : public WorkerTask
+	{
+	public:
+		RefillTask(PrecomputedPool<T> &pool) : m_pool(pool) {}
+		void Run();
+	private:
+		PrecomputedPool<T> &m_pool;
+	};
+
+	void StartRefill();
+	// returns false if the pool is full or being destroyed
+	bool GenerateOne();
+
+	member_ptr<Generator> m_generator;
+	const unsigned int m_capacity, m_refillLevel;
+	RefillTask m_refillTask;
+	member_ptr<WorkerThread> m_refillThread;
+
+	mutable Mutex m_mutex;		// for the members below
+	Mutex m_generatorMutex;		// held while calling m_generator
+	Mutex m_threadMutex;		// held while replacing m_refillThread
+	std::deque<T> m_values;
+	bool m_refilling;			// set by whoever starts a refill, cleared when it ends
+	bool m_stopping;
+	PrecomputedPoolStatistics m_statistics;
+};
+
+// a nonce k for a DSA-like signature scheme, with the part of the signature that doesn't
+// depend on the message, which is g^k mod p mod q for GDSA and NR, or x(kP) mod n for ECDSA
+// and ECNR, and the inverse of k if the scheme needs it
+struct SigningNonce
+{
+	Integer k, r, kInv;
+};
+
+typedef PrecomputedPool<SigningNonce> NoncePool;
+
+// the nonce pool of a DSA-like private key whose nonces k have r = NonceCommitment(P, k) mod q,
+// where P is the precomputation of the base, such as a ModExpPrecomputation, copies share the pool
+template <class P> class SigningNoncePool
+{
+public:
+	// takes ownership of rng, which is only used on the refill thread, dsaForm says whether
+	// Sign() makes DSA or NR signatures, and whether the nonces need r != 0 and kInv
+	void Start(RandomNumberGenerator *rng, const P &precomputation, const Integer &q, bool dsaForm, unsigned int capacity);
+	void Stop() {m_pool = counted_ptr<NoncePool>();}
+	// signs h with the private key x and a nonce from the pool, s = (h+x*r)/k for the DSA form, or
+	// r = (r+h) mod q and s = k-x*r for the NR form, returns false if there is no pool, it is
+	// empty, or the nonce gave s == 0 (DSA) or r == 0 (NR), and another k is needed
+	bool Sign(const Integer &x, const Integer &h, Integer &r, Integer &s) const;
+	// all zero if there is no pool
+	PrecomputedPoolStatistics GetStatistics() const
+		{return m_pool.get() ? m_pool->GetStatistics() : PrecomputedPoolStatistics();}
+
+private:
+	class Generator : public NoncePool::Generator
+	{
+	public:
+		Generator(RandomNumberGenerator *rng, const P &precomputation, const Integer &q, bool dsaForm)
+			: m_rng(rng), m_precomputation(precomputation), m_q(q), m_dsaForm(dsaForm) {}
+		void Generate(SigningNonce &nonce);
+
+	private:
+		member_ptr<RandomNumberGenerator> m_rng;
+		P m_precomputation;	// a copy, so the key's Precompute() can't change it under the refill thread
+		Integer m_q;
+		bool m_dsaForm;
+	};
+
+	mutable counted_ptr<NoncePool> m_pool;	// taken from by const Sign()
+	Integer m_q;
+	bool m_dsaForm;
+};
+
+inline Integer NonceCommitment(const ModExpPrecomputation &gpc, const Integer &k)
+{
+	return gpc.Exponentiate(k);
+}
+
+// a private key with its public key, for a key agreement domain
+struct AgreementKeyPair
+{
+	SecByteBlock privateKey, publicKey;
+};
+
+typedef PrecomputedPool<AgreementKeyPair> KeyPairPool;
+
+// a key agreement domain whose GenerateKeyPair() hands out key pairs generated ahead of
+// time by a background thread, for handshakes that come in bursts, each pair is handed
+// out once and wiped from the pool as it's taken, the other functions call domain's
+class PooledSimpleKeyAgreementDomain : public PK_SimpleKeyAgreementDomain
+{
+public:
+	// domain must outlive this object, which takes ownership of rng and uses it only
+	// on the refill thread, domain's precomputation should be done before this is created
+	PooledSimpleKeyAgreementDomain(const PK_SimpleKeyAgreementDomain &domain, RandomNumberGenerator *rng, unsigned int capacity=64);
+
+	bool ValidateDomainParameters(RandomNumberGenerator &rng) const
+		{return m_domain.ValidateDomainParameters(rng);}
+	unsigned int AgreedValueLength() const {return m_domain.AgreedValueLength();}
+	unsigned int PrivateKeyLength() const {return m_domain.PrivateKeyLength();}
+	unsigned int PublicKeyLength() const {return m_domain.PublicKeyLength();}
+
+	// generates a key pair with rng if the pool is empty
+	void GenerateKeyPair(RandomNumberGenerator &rng, byte *privateKey, byte *publicKey) const;
+	bool Agree(byte *agreedValue, const byte *privateKey, const byte *otherPublicKey, bool validateOtherPublicKey=true) const
+		{return m_domain.Agree(agreedValue, privateKey, otherPublicKey, validateOtherPublicKey);}
+
+	// generates key pairs on the calling thread until the pool is full
+	void FillKeyPairPool() {m_pool.Fill();}
+	PrecomputedPoolStatistics GetKeyPairPoolStatistics() const {return m_pool.GetStatistics();}
+
+private:
+	const PK_SimpleKeyAgreementDomain &m_domain;
+	mutable KeyPairPool m_pool;
+};
+
+// the same for an authenticated key agreement domain, whose GenerateEphemeralKeyPair() is pooled
+class PooledAuthenticatedKeyAgreementDomain : public PK_AuthenticatedKeyAgreementDomain
+{
+public:
+	PooledAuthenticatedKeyAgreementDomain(const PK_AuthenticatedKeyAgreementDomain &domain, RandomNumberGenerator *rng, unsigned int capacity=64);
+
+	bool ValidateDomainParameters(RandomNumberGenerator &rng) const
+		{return m_domain.ValidateDomainParameters(rng);}
+	unsigned int AgreedValueLength() const {return m_domain.AgreedValueLength();}
+
+	unsigned int StaticPrivateKeyLength() const {return m_domain.StaticPrivateKeyLength();}
+	unsigned int StaticPublicKeyLength() const {return m_domain.StaticPublicKeyLength();}
+	void GenerateStaticKeyPair(RandomNumberGenerator &rng, byte *privateKey, byte *publicKey) const
+		{m_domain.GenerateStaticKeyPair(rng, privateKey, publicKey);}
+
+	unsigned int EphemeralPrivateKeyLength() const {return m_domain.EphemeralPrivateKeyLength();}
+	unsigned int EphemeralPublicKeyLength() const {return m_domain.EphemeralPublicKeyLength();}
+	// generates a key pair with rng if the pool is empty
+	void GenerateEphemeralKeyPair(RandomNumberGenerator &rng, byte *privateKey, byte *publicKey) const;
+
+	bool Agree(byte *agreedValue,
+		const byte *staticPrivateKey, const byte *ephemeralPrivateKey,
+		const byte *staticOtherPublicKey, const byte *ephemeralOtherPublicKey,
+		bool validateStaticOtherPublicKey=true) const
+		{return m_domain.Agree(agreedValue, staticPrivateKey, ephemeralPrivateKey, staticOtherPublicKey, ephemeralOtherPublicKey, validateStaticOtherPublicKey);}
+
+	void FillKeyPairPool() {m_pool.Fill();}
+	PrecomputedPoolStatistics GetKeyPairPoolStatistics() const {return m_pool.GetStatistics();}
+
+private:
+	const PK_AuthenticatedKeyAgreementDomain &m_domain;
+	mutable KeyPairPool m_pool;
+};
+
+// ********************************************************
+
+template <class T> PrecomputedPool<T>::PrecomputedPool(Generator *generator, unsigned int capacity, unsigned int refillLevel)
+	: m_referenceCount(0), m_generator(generator), m_capacity(capacity)
+	, m_refillLevel(refillLevel < capacity ? refillLevel : capacity-1)
+	, m_refillTask(*this), m_refilling(true), m_stopping(false)
+{
+	assert(capacity > 0);
+	m_statistics.capacity = capacity;
+	StartRefill();
+}
+
+template <class T> PrecomputedPool<T>::~PrecomputedPool()
+{
+	m_mutex.Lock();
+	m_stopping = true;
+	m_mutex.Unlock();
+
+	MutexLock lock(m_threadMutex);
+	m_refillThread.reset();
+}
+
+template <class T> bool PrecomputedPool<T>::Take(T &value)
+{
+	bool taken, refill;
+	{
+		MutexLock lock(m_mutex);
+		taken = !m_values.empty();
+		if (taken)
+		{
+			value = m_values.front();
+			m_values.pop_front();
+			m_statistics.taken++;
+		}
+		else
+			m_statistics.missed++;
+
+		refill = !m_refilling && !m_stopping && m_values.size() <= m_refillLevel;
+		if (refill)
+			m_refilling = true;
+	}
+
+	if (refill)
+		StartRefill();
+	return taken;
+}
+
+template <class T> void PrecomputedPool<T>::Fill()
+{
+	while (GenerateOne()) {}
+}
+
+template <class T> PrecomputedPoolStatistics PrecomputedPool<T>::GetStatistics() const
+{
+	MutexLock lock(m_mutex);
+	PrecomputedPoolStatistics statistics = m_statistics;
+	statistics.size = m_values.size();
+	return statistics;
+}
+
+// only the caller that set m_refilling may call this
+template <class T> void PrecomputedPool<T>::StartRefill()
+{
+	MutexLock lock(m_threadMutex);
+	m_refillThread.reset();		// waits for the last refill, which has cleared m_refilling
+	m_refillThread.reset(new WorkerThread(m_refillTask));
+
+	MutexLock statisticsLock(m_mutex);
+	m_statistics.refills++;
+}
+
+template <class T> bool PrecomputedPool<T>::GenerateOne()
+{
+	{
+		MutexLock lock(m_mutex);
+		if (m_stopping || m_values.size() >= m_capacity)
+			return false;
+	}
+
+	T value;
+	{
+		MutexLock lock(m_generatorMutex);
+		m_generator->Generate(value);
+	}
+
+	MutexLock lock(m_mutex);
+	if (m_values.size() >= m_capacity)
+		return false;
+	m_values.push_back(value);
+	m_statistics.generated++;
+	return true;
+}
+
+template <class P> void SigningNoncePool<P>::Start(RandomNumberGenerator *rng, const P &precomputation, const Integer &q, bool dsaForm, unsigned int capacity)
+{
+	m_q = q;
+	m_dsaForm = dsaForm;
+	m_pool = counted_ptr<NoncePool>(new NoncePool(new Generator(rng, precomputation, q, dsaForm), capacity, capacity/2));
+}
+
+template <class P> bool SigningNoncePool<P>::Sign(const Integer &x, const Integer &h, Integer &r, Integer &s) const
+{
+	SigningNonce nonce;
+	if (!m_pool.get() || !m_pool->Take(nonce))
+		return false;
+
+	if (m_dsaForm)
+	{
+		r = nonce.r;
+		s = (nonce.kInv * (x*r + h)) % m_q;
+		return !!s;
+	}
+	else
+	{
+		r = (nonce.r + h) % m_q;
+		s = (nonce.k - x*r) % m_q;
+		return !!r;
+	}
+}
+
+template <class P> void SigningNoncePool<P>::Generator::Generate(SigningNonce &nonce)
+{
+	do
+	{
+		nonce.k.Randomize(*m_rng, 2, m_q-2, Integer::ANY);
+		nonce.r = NonceCommitment(m_precomputation, nonce.k) % m_q;
+	} while (m_dsaForm && !nonce.r);
+	if (m_dsaForm)
+		nonce.kInv = EuclideanMultiplicativeInverse(nonce.k, m_q);
+}
+
+template <class T> void PrecomputedPool<T>::RefillTask::Run()
+{
+	try
+	{
+		while (m_pool.GenerateOne()) {}
+	}
+	catch (...)
+	{
+		MutexLock lock(m_pool.m_mutex);
+		m_pool.m_refilling = false;
+		throw;
+	}
+
+	MutexLock lock(m_pool.m_mutex);
+	m_pool.m_refilling = false;
+}
+
+NAMESPACE_END
+
+#endif
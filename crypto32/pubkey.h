@@ -4,6 +4,7 @@
 #include "cryptlib.h"
 #include "misc.h"
 #include <memory>
+#include <vector>
 #include <assert.h>
 
 NAMESPACE_BEGIN(CryptoPP)
@@ -154,6 +155,57 @@ public:
 	virtual bool VerifyDigest(const byte *digest, unsigned int digestLen, const byte *sig) const =0;
 };
 
+// the discrete log VerifyDigests() functions verify a batch with the key's own tables unless
+// BatchPrecomputationPays() for tables of this many precomputed powers of each base
+const unsigned int BATCH_PRECOMPUTATION_STORAGE = 16;
+
+// whether count verifications pay for building tables of BATCH_PRECOMPUTATION_STORAGE powers
+// of both bases, given the key's tables of storage powers: for b bit exponents, building takes
+// about 2*b squarings and a verification about b/storage squarings plus b/2 multiplications,
+// and the saving must cover the building four times over, since these counts leave out the
+// cost of splitting the exponents, which dominates with short segments and small moduli
+inline bool BatchPrecomputationPays(unsigned int count, unsigned int storage)
+{
+	const unsigned int s = BATCH_PRECOMPUTATION_STORAGE;
+	return storage < s && count*(s-storage) > 4*2*(s-1)*storage;
+}
+
+// verifies signatures[i] on digests[i] under *keys[i] for each i < count, where V is a
+// verifier class with a VerifyDigests() member that verifies a batch under one key;
+// sets valid[i] if valid isn't NULL and returns true if all signatures are valid
+template <class V>
+bool BatchVerifyDigests(unsigned int count, const V *const *keys, const byte *const *digests, const unsigned int *digestLens, const byte *const *signatures, bool *valid=NULL)
+{
+	std::vector<std::pair<const V *, unsigned int> > order(count);
+	unsigned int i, j, k;
+	for (i=0; i<count; i++)
+		order[i] = std::make_pair(keys[i], i);
+	std::sort(order.begin(), order.end());
+
+	std::vector<const byte *> d(count), s(count);
+	std::vector<unsigned int> dl(count);
+	SecBlock<bool> results(count);
+	bool pass = true;
+
+	// one call to VerifyDigests() per key, so that its precomputation is shared
+	for (i=0; i<count; i=j)
+	{
+		for (j=i; j<count && order[j].first==order[i].first; j++)
+		{
+			k = order[j].second;
+			d[j-i] = digests[k];
+			dl[j-i] = digestLens[k];
+			s[j-i] = signatures[k];
+		}
+		pass = order[i].first->VerifyDigests(j-i, &d[0], &dl[0], &s[0], results) && pass;
+		if (valid)
+			for (k=i; k<j; k++)
+				valid[order[k].second] = results[k-i];
+	}
+
+	return pass;
+}
+
 template <class P, class T>
 class DigestSignatureSystemBaseTemplate : virtual public DigestSignatureSystem, virtual public PublicKeyBaseTemplate<T>
 {
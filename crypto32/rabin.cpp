@@ -59,6 +59,8 @@ InvertibleRabinFunction::InvertibleRabinFunction(const Integer &n, const Integer
 	assert(Jacobi(s, p) == -1);
 	assert(Jacobi(s, q) == 1);
 	assert(u*q%p==1);
+
+	Precompute();
 }
 
 // generate a random private key
@@ -107,6 +109,8 @@ InvertibleRabinFunction::InvertibleRabinFunction(RandomNumberGenerator &rng, uns
 	assert(n.BitCount() == keybits);
 	u = EuclideanMultiplicativeInverse(q, p);
 	assert(u*q%p==1);
+
+	Precompute();
 }
 
 InvertibleRabinFunction::InvertibleRabinFunction(BufferedTransformation &bt)
@@ -119,6 +123,8 @@ InvertibleRabinFunction::InvertibleRabinFunction(BufferedTransformation &bt)
 	q.BERDecode(seq);
 	u.BERDecode(seq);
 	seq.OutputFinished();
+
+	Precompute();
 }
 
 void InvertibleRabinFunction::DEREncode(BufferedTransformation &bt) const
@@ -133,28 +139,42 @@ void InvertibleRabinFunction::DEREncode(BufferedTransformation &bt) const
 	seq.InputFinished();
 }
 
+void InvertibleRabinFunction::Precompute()
+{
+	ep = (p-3) >> 2;
+	eq = (q-3) >> 2;
+	rp = a_exp_b_mod_c(EuclideanMultiplicativeInverse(r, p), (p+1) >> 2, p);
+	rq = a_exp_b_mod_c(EuclideanMultiplicativeInverse(r, q), (q+1) >> 2, q);
+	sp = a_exp_b_mod_c(EuclideanMultiplicativeInverse(s, p), (p+1) >> 2, p);
+	sq = a_exp_b_mod_c(EuclideanMultiplicativeInverse(s, q), (q+1) >> 2, q);
+	pmr.reset(new MontgomeryRepresentation(p));
+	qmr.reset(new MontgomeryRepresentation(q));
+}
+
 Integer InvertibleRabinFunction::CalculateInverse(const Integer &in) const
 {
-	Integer cp=in%p, cq=in%q;
+	MontgomeryRepresentation pmr(*this->pmr), qmr(*this->qmr);
 
-	int jp = Jacobi(cp, p);
-	int jq = Jacobi(cq, q);
+	// the roots of in mod p and q, and whether in is a square mod each,
+	// come from one exponentiation apiece
+	Integer cp, cq;
+	int jp = ModularSquareRootAndJacobi(cp, in%p, ep, pmr);
+	int jq = ModularSquareRootAndJacobi(cq, in%q, eq, qmr);
 
+	// dividing by r or s before the square root is the same as multiplying
+	// by the precomputed powers of their inverses after it
 	if (jq==-1)
 	{
-		cp = cp*EuclideanMultiplicativeInverse(r, p)%p;
-		cq = cq*EuclideanMultiplicativeInverse(r, q)%q;
+		cp = cp*rp%p;
+		cq = cq*rq%q;
 	}
 
 	if (jp==-1)
 	{
-		cp = cp*EuclideanMultiplicativeInverse(s, p)%p;
-		cq = cq*EuclideanMultiplicativeInverse(s, q)%q;
+		cp = cp*sp%p;
+		cq = cq*sq%q;
 	}
 
-	cp = ModularSquareRoot(cp, p);
-	cq = ModularSquareRoot(cq, q);
-
 	if (jp==-1)
 		cp = p-cp;
 
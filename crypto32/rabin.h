@@ -4,6 +4,8 @@
 #include "oaep.h"
 #include "pssr.h"
 #include "integer.h"
+#include "modarith.h"
+#include "smartptr.h"
 
 NAMESPACE_BEGIN(CryptoPP)
 
@@ -36,7 +38,12 @@ public:
 	Integer CalculateInverse(const Integer &x) const;
 
 protected:
+	void Precompute();
+
 	Integer p, q, u;
+	Integer ep, eq;				// (p-3)/4 and (q-3)/4
+	Integer rp, rq, sp, sq;		// (1/r)**((p+1)/4) mod p, (1/r)**((q+1)/4) mod q, and the same for s
+	value_ptr<MontgomeryRepresentation> pmr, qmr;
 };
 
 template <class B>
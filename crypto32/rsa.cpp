@@ -5,6 +5,7 @@
 #include "asn.h"
 #include "nbtheory.h"
 #include "sha.h"
+#include "thread.h"
 
 #include "pubkey.cpp"
 #include "oaep.cpp"
@@ -15,12 +16,20 @@ INSTANTIATE_PUBKEY_TEMPLATES_MACRO(PKCS_EncryptionPaddingScheme, PKCS_SignatureP
 template class OAEP<SHA>;
 INSTANTIATE_PUBKEY_CRYPTO_TEMPLATES_MACRO(OAEP<SHA>, RSAFunction, InvertibleRSAFunction);
 
+RSAFunction::RSAFunction(const Integer &n, const Integer &e)
+	: n(n), e(e), nmr(n.IsOdd() ? new MontgomeryRepresentation(n) : NULL)
+{
+}
+
 RSAFunction::RSAFunction(BufferedTransformation &bt)
 {
 	BERSequenceDecoder seq(bt);
 	n.BERDecode(seq);
 	e.BERDecode(seq);
 	seq.OutputFinished();
+
+	if (n.IsOdd())
+		nmr.reset(new MontgomeryRepresentation(n));
 }
 
 void RSAFunction::DEREncode(BufferedTransformation &bt) const
@@ -33,24 +42,31 @@ void RSAFunction::DEREncode(BufferedTransformation &bt) const
 
 Integer RSAFunction::ApplyFunction(const Integer &x) const
 {
-	return a_exp_b_mod_c(x, e, n);
+	if (!nmr.get())
+		return a_exp_b_mod_c(x, e, n);
+
+	MontgomeryRepresentation mr(*nmr);
+	return ModularExponentiation(x, e, mr);
 }
 
 // *****************************************************************************
 
 InvertibleRSAFunction::InvertibleRSAFunction(const Integer &n, const Integer &e, const Integer &d,
 	const Integer &p, const Integer &q, const Integer &dp, const Integer &dq, const Integer &u)
-		: RSAFunction(n, e), d(d), p(p), q(q), dp(dp), dq(dq), u(u)
+		: RSAFunction(n, e), d(d), p(p), q(q), dp(dp), dq(dq), u(u), parallelCRT(false)
 {
 	assert(p*q==n);
 	assert(d*e%LCM(p-1, q-1)==1);
 	assert(dp==d%(p-1));
 	assert(dq==d%(q-1));
 	assert(u*q%p==1);
+
+	PrecomputeMontgomery();
 }
 
 // generate a random private key
 InvertibleRSAFunction::InvertibleRSAFunction(RandomNumberGenerator &rng, unsigned int keybits, const Integer &eStart)
+	: parallelCRT(false)
 {
 	assert(keybits >= 16);
 	// generate 2 random primes of suitable size
@@ -79,9 +95,13 @@ InvertibleRSAFunction::InvertibleRSAFunction(RandomNumberGenerator &rng, unsigne
 	u = EuclideanMultiplicativeInverse(q, p);
 	n = p * q;
 	assert(n.BitCount() == keybits);
+
+	nmr.reset(new MontgomeryRepresentation(n));
+	PrecomputeMontgomery();
 }
 
 InvertibleRSAFunction::InvertibleRSAFunction(BufferedTransformation &bt)
+	: parallelCRT(false)
 {
 	BERSequenceDecoder seq(bt);
 	word32 version;
@@ -95,6 +115,10 @@ InvertibleRSAFunction::InvertibleRSAFunction(BufferedTransformation &bt)
 	dq.BERDecode(seq);
 	u.BERDecode(seq);
 	seq.OutputFinished();
+
+	if (n.IsOdd())
+		nmr.reset(new MontgomeryRepresentation(n));
+	PrecomputeMontgomery();
 }
 
 void InvertibleRSAFunction::DEREncode(BufferedTransformation &bt) const
@@ -112,11 +136,85 @@ void InvertibleRSAFunction::DEREncode(BufferedTransformation &bt) const
 	seq.InputFinished();
 }
 
+void InvertibleRSAFunction::PrecomputeMontgomery()
+{
+	// p and q are odd for any valid key, but don't choke on a bad one
+	pmr.reset(p.IsOdd() ? new MontgomeryRepresentation(p) : NULL);
+	qmr.reset(q.IsOdd() ? new MontgomeryRepresentation(q) : NULL);
+}
+
+ANONYMOUS_NAMESPACE_BEGIN
+class ModularExponentiationTask : public WorkerTask
+{
+public:
+	ModularExponentiationTask(const MontgomeryRepresentation &mr, const Integer &a, const Integer &e)
+		: mr(mr), a(a), e(e) {}
+
+	void Run()
+		{result = mr.ConvertOut(mr.FixedWindowExponentiate(mr.ConvertIn(a), e, mr.GetModulus().BitCount()));}
+
+	Integer result;
+
+private:
+	const MontgomeryRepresentation &mr;
+	const Integer &a, &e;
+};
+NAMESPACE_END
+
 Integer InvertibleRSAFunction::CalculateInverse(const Integer &x) const 
 {
 	// here we follow the notation of PKCS #1 and let u=q inverse mod p
 	// but in ModRoot, u=p inverse mod q, so we reverse the order of p and q
-	return ModularRoot(x, dq, dp, q, p, u);
+	if (!pmr.get() || !qmr.get())
+		return ModularRoot(x, dq, dp, q, p, u);
+
+	MontgomeryRepresentation pmr(*this->pmr), qmr(*this->qmr);
+	if (!parallelCRT)
+		return CalculateInverse(x, pmr, qmr);
+
+	// pmr and qmr each have their own workspace, so the two halves can run at the same time
+	ModularExponentiationTask pTask(pmr, x, dp), qTask(qmr, x, dq);
+	WorkerThread thread(pTask);
+	qTask.Run();
+	thread.Join();
+	return CRT(qTask.result, q, pTask.result, p, u);
+}
+
+Integer InvertibleRSAFunction::CalculateInverse(const Integer &x, const MontgomeryRepresentation &pmr, const MontgomeryRepresentation &qmr) const
+{
+	return ModularRoot(x, dq, dp, qmr, pmr, u);
+}
+
+class InvertibleRSAFunction::InverseBatch : public BatchProcessor
+{
+public:
+	InverseBatch(const InvertibleRSAFunction &f, Integer *y, const Integer *x)
+		: f(f), y(y), x(x) {}
+
+	void ProcessBatch(unsigned int begin, unsigned int count) const
+	{
+		if (f.pmr.get() && f.qmr.get())
+		{
+			MontgomeryRepresentation pmr(*f.pmr), qmr(*f.qmr);
+			for (unsigned int i=begin; i<begin+count; i++)
+				y[i] = f.CalculateInverse(x[i], pmr, qmr);
+		}
+		else
+		{
+			for (unsigned int i=begin; i<begin+count; i++)
+				y[i] = f.CalculateInverse(x[i]);
+		}
+	}
+
+private:
+	const InvertibleRSAFunction &f;
+	Integer *y;
+	const Integer *x;
+};
+
+void InvertibleRSAFunction::CalculateInverses(Integer *y, const Integer *x, unsigned int count, unsigned int threadCount) const
+{
+	RunBatch(InverseBatch(*this, y, x), count, threadCount);
 }
 
 NAMESPACE_END
@@ -4,13 +4,15 @@
 #include "pkcspad.h"
 #include "oaep.h"
 #include "integer.h"
+#include "modarith.h"
+#include "smartptr.h"
 
 NAMESPACE_BEGIN(CryptoPP)
 
 class RSAFunction : virtual public TrapdoorFunction
 {
 public:
-	RSAFunction(const Integer &n, const Integer &e) : n(n), e(e) {}
+	RSAFunction(const Integer &n, const Integer &e);
 	RSAFunction(BufferedTransformation &bt);
 	void DEREncode(BufferedTransformation &bt) const;
 
@@ -24,6 +26,7 @@ public:
 protected:
 	RSAFunction() {}	// to be used only by InvertibleRSAFunction
 	Integer n, e;	// these are only modified in constructors
+	value_ptr<MontgomeryRepresentation> nmr;	// precomputed for n, NULL if n is even
 };
 
 class InvertibleRSAFunction : public RSAFunction, public InvertibleTrapdoorFunction
@@ -37,13 +40,30 @@ public:
 	void DEREncode(BufferedTransformation &bt) const;
 
 	Integer CalculateInverse(const Integer &x) const;
+	// sets y[i] = CalculateInverse(x[i]) for each i < count, dividing the work among
+	// threadCount threads, including the calling one, that share this key and
+	// use their own copies of its Montgomery representations
+	void CalculateInverses(Integer *y, const Integer *x, unsigned int count, unsigned int threadCount) const;
+
+	// if set, CalculateInverse() does its mod p and mod q exponentiations on two threads,
+	// which lowers its latency on a multiprocessor but costs a thread creation per call
+	void SetParallelCRT(bool parallel) {parallelCRT = parallel;}
+	bool GetParallelCRT() const {return parallelCRT;}
 
 	const Integer& GetPrime1() const {return p;}
 	const Integer& GetPrime2() const {return q;}
 	const Integer& GetDecryptionExponent() const {return d;}
 
 protected:
+	void PrecomputeMontgomery();
+	// the CRT on the calling thread, with the caller's copies of the Montgomery representations
+	Integer CalculateInverse(const Integer &x, const MontgomeryRepresentation &pmr, const MontgomeryRepresentation &qmr) const;
+
+	class InverseBatch;
+
 	Integer d, p, q, dp, dq, u;
+	value_ptr<MontgomeryRepresentation> pmr, qmr;
+	bool parallelCRT;
 };
 
 template <class B>
@@ -135,6 +135,8 @@ InvertibleRWFunction<r>::InvertibleRWFunction(const Integer &n, const Integer &p
 {
 	assert(p*q==n);
 	assert(u*q%p==1);
+
+	Precompute();
 }
 
 // generate a random private key
@@ -162,6 +164,8 @@ InvertibleRWFunction<r>::InvertibleRWFunction(RandomNumberGenerator &rng, unsign
 	assert(n.BitCount() == keybits);
 	u = EuclideanMultiplicativeInverse(q, p);
 	assert(u*q%p==1);
+
+	Precompute();
 }
 
 template <word r>
@@ -173,6 +177,8 @@ InvertibleRWFunction<r>::InvertibleRWFunction(BufferedTransformation &bt)
 	q.BERDecode(seq);
 	u.BERDecode(seq);
 	seq.OutputFinished();
+
+	Precompute();
 }
 
 template <word r>
@@ -191,20 +197,36 @@ void InvertibleRWFunction<r>::DEREncode(BufferedTransformation &bt) const
 	seq.InputFinished();
 }
 
+template <word r>
+void InvertibleRWFunction<r>::Precompute()
+{
+	ep = (p-3) >> 2;
+	eq = (q-3) >> 2;
+	hp = a_exp_b_mod_c((p+1) >> 1, (p+1) >> 2, p);
+	hq = a_exp_b_mod_c((q+1) >> 1, (q+1) >> 2, q);
+	pmr.reset(new MontgomeryRepresentation(p));
+	qmr.reset(new MontgomeryRepresentation(q));
+}
+
 template <word r>
 Integer InvertibleRWFunction<r>::CalculateInverse(const Integer &in) const
 {
-	Integer cp=in%p, cq=in%q;
+	MontgomeryRepresentation pmr(*this->pmr), qmr(*this->qmr);
 
-	if (Jacobi(cp, p) * Jacobi(cq, q) != 1)
+	// the roots of in mod p and q, and whether in is a square mod each,
+	// come from one exponentiation apiece
+	Integer cp, cq;
+	int jp = ModularSquareRootAndJacobi(cp, in%p, ep, pmr);
+	int jq = ModularSquareRootAndJacobi(cq, in%q, eq, qmr);
+
+	// halving before the square root is the same as multiplying by a
+	// precomputed root of 1/2 after it
+	if (jp * jq != 1)
 	{
-		cp = cp%2 ? (cp+p) >> 1 : cp >> 1;
-		cq = cq%2 ? (cq+q) >> 1 : cq >> 1;
+		cp = cp*hp%p;
+		cq = cq*hq%q;
 	}
 
-	cp = ModularSquareRoot(cp, p);
-	cq = ModularSquareRoot(cq, q);
-
 	Integer out = CRT(cq, q, cp, p, u);
 
 	return STDMIN(out, n-out);
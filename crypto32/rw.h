@@ -3,6 +3,8 @@
 
 #include "pubkey.h"
 #include "integer.h"
+#include "modarith.h"
+#include "smartptr.h"
 
 NAMESPACE_BEGIN(CryptoPP)
 
@@ -95,7 +97,12 @@ public:
 	const Integer& GetPrime2() const {return q;}
 
 protected:
+	void Precompute();
+
 	Integer p, q, u;
+	Integer ep, eq;		// (p-3)/4 and (q-3)/4
+	Integer hp, hq;		// (1/2)**((p+1)/4) mod p and (1/2)**((q+1)/4) mod q
+	value_ptr<MontgomeryRepresentation> pmr, qmr;
 };
 
 template <class H>
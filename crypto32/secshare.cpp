@@ -5,6 +5,7 @@
 #include "queue.h"
 #include "algebra.h"
 #include "gf2_32.h"
+#include "gf256.h"
 #include "polynomi.h"
 
 #include "algebra.cpp"
@@ -41,6 +42,93 @@ template<> const Field Polynomial::fixedRing(field);
 
 NAMESPACE_BEGIN(CryptoPP)
 
+// ****************************************************************
+// GF(2^8) matrix arithmetic for DisperseFork::GF256_FORMAT
+
+static const GF256 byteField(0x1D);		// x^8+x^4+x^3+x^2+1
+
+// set in the threshold field of the share headers
+static const word32 GF256_FORMAT_FLAG = 0x80000000;
+
+// table[u] = c*u and table[16+u] = c*(u<<4) for each 4-bit u, so c*b = table[b&15] ^ table[16+(b>>4)]
+static void MakeMultiplicationTable(byte *table, byte c)
+{
+	for (unsigned int u=0; u<16; u++)
+	{
+		table[u] = byteField.Multiply(c, byte(u));
+		table[16+u] = byteField.Multiply(c, byte(u<<4));
+	}
+}
+
+#ifdef X86_64_ASSEMBLY
+static bool HasSSSE3()
+{
+	word32 a, b, c, d;
+	__asm__ ("cpuid" : "=a" (a), "=b" (b), "=c" (c), "=d" (d) : "a" (1), "c" (0));
+	return (c & 0x200) != 0;	// PSHUFB
+}
+
+// dst[0..16*blocks) ^= c*src[0..16*blocks), looking up both halves of 16 bytes at a time with PSHUFB
+static void MultiplyAccumulateBlocks(byte *dst, const byte *src, const byte *table, word blocks)
+{
+	static const byte lowNibbles[16] = {15,15,15,15,15,15,15,15,15,15,15,15,15,15,15,15};
+
+	__asm__ __volatile__
+	(
+		"movdqu (%3), %%xmm5\n\t"
+		"movdqu 16(%3), %%xmm6\n\t"
+		"movdqu (%4), %%xmm7\n\t"
+		"1:\n\t"
+		"movdqu (%1), %%xmm0\n\t"
+		"movdqa %%xmm0, %%xmm1\n\t"
+		"psrlw $4, %%xmm1\n\t"
+		"pand %%xmm7, %%xmm0\n\t"
+		"pand %%xmm7, %%xmm1\n\t"
+		"movdqa %%xmm5, %%xmm2\n\t"
+		"movdqa %%xmm6, %%xmm3\n\t"
+		"pshufb %%xmm0, %%xmm2\n\t"
+		"pshufb %%xmm1, %%xmm3\n\t"
+		"pxor %%xmm3, %%xmm2\n\t"
+		"movdqu (%0), %%xmm4\n\t"
+		"pxor %%xmm4, %%xmm2\n\t"
+		"movdqu %%xmm2, (%0)\n\t"
+		"add $16, %0\n\t"
+		"add $16, %1\n\t"
+		"sub $1, %2\n\t"
+		"jnz 1b"
+		: "+r" (dst), "+r" (src), "+r" (blocks)
+		: "r" (table), "r" (lowNibbles)
+		: "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5", "xmm6", "xmm7", "memory", "cc"
+	);
+}
+#endif
+
+// dst[0..length) ^= c*src[0..length), where table was made by MakeMultiplicationTable() for c
+static void MultiplyAccumulate(byte *dst, const byte *src, const byte *table, unsigned int length)
+{
+	unsigned int i=0;
+
+#ifdef X86_64_ASSEMBLY
+	static const bool hasSSSE3 = HasSSSE3();
+	if (hasSSSE3 && length >= 16)
+	{
+		MultiplyAccumulateBlocks(dst, src, table, length/16);
+		i = length - length%16;
+	}
+#endif
+
+	for (; i<length; i++)
+		dst[i] ^= table[src[i] & 15] ^ table[16 + (src[i] >> 4)];
+}
+
+// out[0..length) = the sum over j of c[j]*rows[j][0..length), with the tables for c[0..count) in a row
+static void MultiplyRows(byte *out, const byte *tables, const byte *const *rows, unsigned int count, unsigned int length)
+{
+	memset(out, 0, length);
+	for (unsigned int j=0; j<count; j++)
+		MultiplyAccumulate(out, rows[j], tables+32*j, length);
+}
+
 ShareFork::ShareFork(RandomNumberGenerator &rng, word32 m, word32 n, BufferedTransformation *const *outports)
 	: Fork(n, outports), m_rng(rng), m_threshold(m), m_count(0)
 {
@@ -163,10 +251,86 @@ void ShareJoin::Output(word32 message)
 
 // ************************************************************
 
-DisperseFork::DisperseFork(unsigned int m, unsigned int n, BufferedTransformation *const *outports)
-	: ShareFork(*(RandomNumberGenerator *)0, m, n, outports),
-	  m_poly(m), m_polyCount(0)
+DisperseFork::DisperseFork(unsigned int m, unsigned int n, BufferedTransformation *const *outports, Format format)
+	: ShareFork(*(RandomNumberGenerator *)0, format==GF256_FORMAT && n<=255 ? m|GF256_FORMAT_FLAG : m, n, outports),
+	  m_poly(m), m_polyCount(0), m_format(n<=255 ? format : GF2_32_FORMAT), m_chunkCount(0)
 {
+	m_threshold = m;
+
+	if (m_format == GF256_FORMAT)
+	{
+		assert(m > 0 && m <= n);
+		m_chunk.New(m*GF256_ROW_LENGTH);
+		m_share.New(GF256_ROW_LENGTH);
+
+		// share i is the value at x=i+1 of the polynomials whose coefficients are the rows,
+		// so row i of the matrix is 1, x, x^2, ..., x^(m-1)
+		m_tables.New(32*n*m);
+		for (unsigned int i=0; i<n; i++)
+		{
+			byte c = 1;
+			for (unsigned int j=0; j<m; j++)
+			{
+				MakeMultiplicationTable(m_tables+32*(i*m+j), c);
+				c = byteField.Multiply(c, byte(i+1));
+			}
+		}
+	}
+}
+
+void DisperseFork::Put(byte inByte)
+{
+	if (m_format == GF2_32_FORMAT)
+		ShareFork::Put(inByte);
+	else
+		Put(&inByte, 1);
+}
+
+void DisperseFork::Put(const byte *inString, unsigned int length)
+{
+	if (m_format == GF2_32_FORMAT)
+	{
+		ShareFork::Put(inString, length);
+		return;
+	}
+
+	const unsigned int chunkSize = m_threshold*GF256_ROW_LENGTH;
+	while (length)
+	{
+		if (m_chunkCount == 0 && length >= chunkSize)
+		{
+			// whole chunks are dispersed straight from the input
+			DisperseChunk(inString, GF256_ROW_LENGTH);
+			inString += chunkSize;
+			length -= chunkSize;
+			continue;
+		}
+
+		unsigned int len = STDMIN(length, chunkSize-m_chunkCount);
+		memcpy(m_chunk+m_chunkCount, inString, len);
+		m_chunkCount += len;
+		inString += len;
+		length -= len;
+
+		if (m_chunkCount == chunkSize)
+		{
+			DisperseChunk(m_chunk, GF256_ROW_LENGTH);
+			m_chunkCount = 0;
+		}
+	}
+}
+
+void DisperseFork::DisperseChunk(const byte *chunk, unsigned int rowLength)
+{
+	std::vector<const byte *> rows(m_threshold);
+	for (unsigned int j=0; j<m_threshold; j++)
+		rows[j] = chunk + j*rowLength;
+
+	for (unsigned int i=0; i<NumberOfPorts(); i++)
+	{
+		MultiplyRows(m_share, m_tables+32*m_threshold*i, &rows[0], m_threshold, rowLength);
+		AccessPort(i).Put(m_share, rowLength);
+	}
 }
 
 void DisperseFork::Share(word32 message)
@@ -186,6 +350,19 @@ void DisperseFork::Share(word32 message)
 
 void DisperseFork::InputFinished()
 {
+	if (m_format == GF256_FORMAT)
+	{
+		// pad the last chunk to a multiple of m bytes with 1 to m bytes of the pad length,
+		// the chunk size is a multiple of m so the padding fits
+		byte filler = byte(m_threshold - m_chunkCount%m_threshold);
+		memset(m_chunk+m_chunkCount, filler, filler);
+		m_chunkCount += filler;
+
+		DisperseChunk(m_chunk, m_chunkCount/m_threshold);
+		m_chunkCount = 0;
+		return;
+	}
+
 	ShareFork::InputFinished();
 
 	word32 filler = m_threshold - m_polyCount;
@@ -194,12 +371,108 @@ void DisperseFork::InputFinished()
 }
 
 DisperseJoin::DisperseJoin(unsigned int n, BufferedTransformation *outQ)
-	: ShareJoin(n, outQ), m_firstPolyOutput(true)
+	: ShareJoin(n, outQ), m_firstPolyOutput(true), m_gf256Format(false), m_pendingLength(0)
 {
 }
 
+void DisperseJoin::PrepareGF256Format()
+{
+	m_threshold &= ~GF256_FORMAT_FLAG;
+	m_gf256Format = true;
+
+	const unsigned int m = m_threshold;
+	if (m == 0 || m > NumberOfPorts())
+		throw Exception("DisperseJoin: the threshold is zero or larger than the number of shares");
+
+	unsigned int i, j, k;
+	for (i=0; i<m; i++)
+		if (m_x[i] == 0 || m_x[i] > 255)
+			throw Exception("DisperseJoin: share index out of range");
+
+	// invert the matrix made by DisperseFork for the first m shares, with Gauss-Jordan elimination
+	SecByteBlock a(m*m), b(m*m);
+	for (i=0; i<m; i++)
+	{
+		byte c = 1;
+		for (j=0; j<m; j++)
+		{
+			a[i*m+j] = c;
+			b[i*m+j] = (i==j);
+			c = byteField.Multiply(c, byte(m_x[i]));
+		}
+	}
+
+	for (j=0; j<m; j++)
+	{
+		for (i=j; i<m && !a[i*m+j]; i++) {}
+		if (i==m)
+			throw Exception("DisperseJoin: two of the shares have the same index");
+
+		for (k=0; k<m; k++)
+		{
+			std::swap(a[i*m+k], a[j*m+k]);
+			std::swap(b[i*m+k], b[j*m+k]);
+		}
+
+		const byte pivotInverse = byteField.MultiplicativeInverse(a[j*m+j]);
+		for (k=0; k<m; k++)
+		{
+			a[j*m+k] = byteField.Multiply(a[j*m+k], pivotInverse);
+			b[j*m+k] = byteField.Multiply(b[j*m+k], pivotInverse);
+		}
+
+		for (i=0; i<m; i++)
+		{
+			const byte c = a[i*m+j];
+			if (i==j || !c)
+				continue;
+			for (k=0; k<m; k++)
+			{
+				a[i*m+k] ^= byteField.Multiply(c, a[j*m+k]);
+				b[i*m+k] ^= byteField.Multiply(c, b[j*m+k]);
+			}
+		}
+	}
+
+	m_tables.New(32*m*m);
+	for (i=0; i<m*m; i++)
+		MakeMultiplicationTable(m_tables+32*i, b[i]);
+
+	m_shares.New(NumberOfPorts()*DisperseFork::GF256_ROW_LENGTH);
+	m_pending.New(m*DisperseFork::GF256_ROW_LENGTH);
+}
+
+void DisperseJoin::AssembleChunk(unsigned int rowLength)
+{
+	// shares after the first m are read and dropped
+	std::vector<const byte *> rows(NumberOfPorts());
+	unsigned int i;
+	for (i=0; i<NumberOfPorts(); i++)
+	{
+		rows[i] = m_shares + i*rowLength;
+		AccessPort(i).Get(m_shares + i*rowLength, rowLength);
+	}
+
+	if (m_pendingLength)
+		AttachedTransformation()->Put(m_pending, m_pendingLength);
+
+	for (i=0; i<m_threshold; i++)
+		MultiplyRows(m_pending + i*rowLength, m_tables+32*m_threshold*i, &rows[0], m_threshold, rowLength);
+	m_pendingLength = m_threshold*rowLength;
+}
+
 void DisperseJoin::Assemble(unsigned long n)
 {
+	if (m_threshold & GF256_FORMAT_FLAG)
+		PrepareGF256Format();
+
+	if (m_gf256Format)
+	{
+		for (; n>=DisperseFork::GF256_ROW_LENGTH; n-=DisperseFork::GF256_ROW_LENGTH)
+			AssembleChunk(DisperseFork::GF256_ROW_LENGTH);
+		return;
+	}
+
 	while (n>=4)
 	{
 		SecBlock<word32> y(NumberOfPorts());
@@ -230,6 +503,27 @@ void DisperseJoin::Assemble(unsigned long n)
 
 void DisperseJoin::NotifyClose(unsigned int id)
 {
+	if (m_gf256Format)
+	{
+		if (InterfacesOpen() == 1)
+		{
+			// the rest is shorter than a row, and always ends the stream with some padding
+			unsigned long n = AccessPort(0).MaxRetrieveable();
+			for (unsigned int i=1; i<NumberOfPorts(); i++)
+				n = STDMIN(n, AccessPort(i).MaxRetrieveable());
+			if (n)
+				AssembleChunk(n);
+
+			byte filler = m_pendingLength ? m_pending[m_pendingLength-1] : 0;
+			if (filler <= m_pendingLength)
+				AttachedTransformation()->Put(m_pending, m_pendingLength-filler);
+			m_pendingLength = 0;
+		}
+
+		Join::NotifyClose(id);
+		return;
+	}
+
 	if (InterfacesOpen() == 1)
 	{
 		word32 filler = m_polyBuffer[m_threshold-1];
@@ -49,15 +49,32 @@ protected:
 class DisperseFork : public ShareFork
 {
 public:
-	DisperseFork(unsigned int m, unsigned int n, BufferedTransformation *const *outports = NULL);
+	// GF2_32_FORMAT is the original one, it evaluates a polynomial over GF(2^32) for every m words
+	// of input. GF256_FORMAT splits each chunk of m*GF256_ROW_LENGTH input bytes into m rows and
+	// multiplies them by a Vandermonde matrix over GF(2^8), which is many times faster, but it
+	// allows at most 255 shares, so more than that are always made in GF2_32_FORMAT.
+	// DisperseJoin reads both.
+	enum Format {GF2_32_FORMAT, GF256_FORMAT};
+	enum {GF256_ROW_LENGTH = 4096};
 
+	DisperseFork(unsigned int m, unsigned int n, BufferedTransformation *const *outports = NULL,
+				 Format format = GF256_FORMAT);
+
+	void Put(byte inByte);
+	void Put(const byte *inString, unsigned int length);
 	virtual void InputFinished();
 
 protected:
 	virtual void Share(word32 message);
+	void DisperseChunk(const byte *chunk, unsigned int rowLength);
 
 	SecBlock<word32> m_poly;
 	unsigned int m_polyCount;
+
+	Format m_format;
+	SecByteBlock m_chunk, m_share;
+	unsigned int m_chunkCount;
+	SecByteBlock m_tables;		// multiplication tables for the matrix entries
 };
 
 class DisperseJoin : public ShareJoin
@@ -69,9 +86,16 @@ public:
 
 protected:
 	virtual void Assemble(unsigned long);
+	void PrepareGF256Format();
+	void AssembleChunk(unsigned int rowLength);
 
 	SecBlock<word32> m_polyBuffer;
 	bool m_firstPolyOutput;
+
+	bool m_gf256Format;
+	SecByteBlock m_tables;		// multiplication tables for the inverse matrix entries
+	SecByteBlock m_shares, m_pending;
+	unsigned int m_pendingLength;	// the last chunk is held back until its padding can be removed
 };
 
 NAMESPACE_END
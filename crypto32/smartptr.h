@@ -42,6 +42,49 @@ template <class T> void member_ptr<T>::reset(T *p) {delete m_p; m_p = p;}
 
 // ********************************************************
 
+template<class T> class value_ptr
+{
+public:
+	explicit value_ptr(T *p = 0) : m_p(p) {}
+	value_ptr(const value_ptr<T>& rhs);
+
+	~value_ptr();
+
+	const T& operator*() const { return *m_p; }
+	T& operator*() { return *m_p; }
+
+	const T* operator->() const { return m_p; }
+	T* operator->() { return m_p; }
+
+	const T* get() const { return m_p; }
+	T* get() { return m_p; }
+
+	void reset(T *p = 0);
+
+	value_ptr<T>& operator=(const value_ptr<T>& rhs);
+
+private:
+	T *m_p;
+};
+
+template <class T> value_ptr<T>::value_ptr(const value_ptr<T>& rhs)
+	: m_p(rhs.m_p ? new T(*rhs.m_p) : 0)
+{
+}
+
+template <class T> value_ptr<T>::~value_ptr() {delete m_p;}
+template <class T> void value_ptr<T>::reset(T *p) {delete m_p; m_p = p;}
+
+template <class T> value_ptr<T>& value_ptr<T>::operator=(const value_ptr<T>& rhs)
+{
+	T *old_p = m_p;
+	m_p = rhs.m_p ? new T(*rhs.m_p) : 0;
+	delete old_p;
+	return *this;
+}
+
+// ********************************************************
+
 template<class T> class counted_ptr
 {
 public:
@@ -538,6 +538,8 @@ bool Validate(int alg)
 	case 47: return CipherModesValidate();
 	case 48: return CRC32Validate();
 	case 49: return ECDSAValidate();
+	case 50: return IntegerValidate();
+	case 51: return DisperseValidate();
 	default: return ValidateAll();
 	}
 }
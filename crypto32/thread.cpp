@@ -0,0 +1,290 @@
+// thread.cpp - written and placed in the public domain by Wei Dai
+
+#include "pch.h"
+#include "thread.h"
+#include "integer.h"
+#include "gf2n.h"
+#include "modarith.h"
+
+#ifdef THREADS_AVAILABLE
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <pthread.h>
+#endif
+#endif
+
+#include <new>
+#include <vector>
+
+NAMESPACE_BEGIN(CryptoPP)
+
+#ifdef THREADS_AVAILABLE
+
+#ifdef _WIN32
+
+struct WorkerThread::Handle
+{
+	HANDLE thread;
+};
+
+static unsigned int __stdcall WorkerThreadEntry(void *p)
+{
+	((WorkerThread *)p)->Execute();
+	return 0;
+}
+
+static WorkerThread::Handle * StartThread(WorkerThread *thread)
+{
+	unsigned int id;
+	HANDLE h = (HANDLE)_beginthreadex(NULL, 0, WorkerThreadEntry, thread, 0, &id);
+	if (!h)
+		return NULL;
+	WorkerThread::Handle *handle = new WorkerThread::Handle;
+	handle->thread = h;
+	return handle;
+}
+
+static void JoinThread(WorkerThread::Handle *handle)
+{
+	WaitForSingleObject(handle->thread, INFINITE);
+	CloseHandle(handle->thread);
+}
+
+struct Mutex::Handle
+{
+	CRITICAL_SECTION section;
+};
+
+Mutex::Mutex()
+	: m_handle(new Handle)
+{
+	InitializeCriticalSection(&m_handle->section);
+}
+
+Mutex::~Mutex()
+{
+	DeleteCriticalSection(&m_handle->section);
+	delete m_handle;
+}
+
+void Mutex::Lock()
+{
+	EnterCriticalSection(&m_handle->section);
+}
+
+void Mutex::Unlock()
+{
+	LeaveCriticalSection(&m_handle->section);
+}
+
+#else
+
+struct WorkerThread::Handle
+{
+	pthread_t thread;
+};
+
+extern "C" {
+static void * WorkerThreadEntry(void *p)
+{
+	((WorkerThread *)p)->Execute();
+	return NULL;
+}
+}
+
+static WorkerThread::Handle * StartThread(WorkerThread *thread)
+{
+	WorkerThread::Handle *handle = new WorkerThread::Handle;
+	if (pthread_create(&handle->thread, NULL, WorkerThreadEntry, thread) != 0)
+	{
+		delete handle;
+		return NULL;
+	}
+	return handle;
+}
+
+static void JoinThread(WorkerThread::Handle *handle)
+{
+	pthread_join(handle->thread, NULL);
+}
+
+struct Mutex::Handle
+{
+	pthread_mutex_t mutex;
+};
+
+Mutex::Mutex()
+	: m_handle(new Handle)
+{
+	pthread_mutex_init(&m_handle->mutex, NULL);
+}
+
+Mutex::~Mutex()
+{
+	pthread_mutex_destroy(&m_handle->mutex);
+	delete m_handle;
+}
+
+void Mutex::Lock()
+{
+	pthread_mutex_lock(&m_handle->mutex);
+}
+
+void Mutex::Unlock()
+{
+	pthread_mutex_unlock(&m_handle->mutex);
+}
+
+#endif
+
+#else	// THREADS_AVAILABLE
+
+struct Mutex::Handle
+{
+};
+
+Mutex::Mutex() : m_handle(NULL) {}
+Mutex::~Mutex() {}
+void Mutex::Lock() {}
+void Mutex::Unlock() {}
+
+#endif	// THREADS_AVAILABLE
+
+// a copy of an exception that a task threw, which Join() throws again on the calling thread
+class WorkerThread::Failure
+{
+public:
+	virtual ~Failure() {}
+	virtual void Rethrow() const =0;
+};
+
+ANONYMOUS_NAMESPACE_BEGIN
+template <class E> class ExceptionCopy : public WorkerThread::Failure
+{
+public:
+	ExceptionCopy(const E &e) : m_e(e) {}
+	void Rethrow() const {throw m_e;}
+
+private:
+	E m_e;
+};
+NAMESPACE_END
+
+WorkerThread::WorkerThread(WorkerTask &task)
+	: m_task(task), m_handle(NULL), m_failure(NULL), m_done(false)
+{
+#ifdef THREADS_AVAILABLE
+	m_handle = StartThread(this);
+#endif
+}
+
+WorkerThread::~WorkerThread()
+{
+#ifdef THREADS_AVAILABLE
+	if (m_handle)
+	{
+		JoinThread(m_handle);
+		delete m_handle;
+	}
+#endif
+	delete m_failure;
+}
+
+void WorkerThread::Execute()
+{
+	try
+	{
+		m_task.Run();
+	}
+	// the exceptions that the tasks of the library's own threads can throw
+	catch (const Integer::DivideByZero &e)
+		{m_failure = new ExceptionCopy<Integer::DivideByZero>(e);}
+	catch (const Integer::RandomNumberNotFound &e)
+		{m_failure = new ExceptionCopy<Integer::RandomNumberNotFound>(e);}
+	catch (const PolynomialMod2::DivideByZero &e)
+		{m_failure = new ExceptionCopy<PolynomialMod2::DivideByZero>(e);}
+	catch (const ModularArithmetic::UnsupportedModulus &e)
+		{m_failure = new ExceptionCopy<ModularArithmetic::UnsupportedModulus>(e);}
+	catch (const std::bad_alloc &e)
+		{m_failure = new ExceptionCopy<std::bad_alloc>(e);}
+	catch (const Exception &e)
+		{m_failure = new ExceptionCopy<Exception>(e);}
+	catch (...)
+		{m_failure = new ExceptionCopy<Err>(Err("WorkerThread: task threw an exception"));}
+}
+
+void WorkerThread::Join()
+{
+	if (!m_done)
+	{
+#ifdef THREADS_AVAILABLE
+		if (m_handle)
+		{
+			JoinThread(m_handle);
+			delete m_handle;
+			m_handle = NULL;
+		}
+		else
+#endif
+			Execute();
+		m_done = true;
+	}
+
+	if (m_failure)
+		m_failure->Rethrow();
+}
+
+void RunWorkerTasks(WorkerTask *const *tasks, unsigned int count)
+{
+	if (count == 0)
+		return;
+	if (count == 1)
+	{
+		tasks[0]->Run();
+		return;
+	}
+
+	WorkerThread thread(*tasks[0]);
+	RunWorkerTasks(tasks+1, count-1);
+	thread.Join();
+}
+
+ANONYMOUS_NAMESPACE_BEGIN
+class BatchTask : public WorkerTask
+{
+public:
+	BatchTask(const BatchProcessor &processor, unsigned int begin, unsigned int count)
+		: m_processor(&processor), m_begin(begin), m_count(count) {}
+
+	void Run()
+		{m_processor->ProcessBatch(m_begin, m_count);}
+
+private:
+	const BatchProcessor *m_processor;
+	unsigned int m_begin, m_count;
+};
+NAMESPACE_END
+
+void RunBatch(const BatchProcessor &processor, unsigned int count, unsigned int threadCount)
+{
+	threadCount = STDMAX(1U, STDMIN(threadCount, count));
+
+	std::vector<BatchTask> tasks;
+	tasks.reserve(threadCount);
+	const unsigned int share = count / threadCount, extra = count % threadCount;
+	for (unsigned int i=0, begin=0; i<threadCount; i++)
+	{
+		unsigned int size = share + (i < extra);
+		tasks.push_back(BatchTask(processor, begin, size));
+		begin += size;
+	}
+
+	std::vector<WorkerTask *> taskPointers(threadCount);
+	for (unsigned int j=0; j<threadCount; j++)
+		taskPointers[j] = &tasks[j];
+	RunWorkerTasks(&taskPointers[0], threadCount);
+}
+
+NAMESPACE_END
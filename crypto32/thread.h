@@ -0,0 +1,104 @@
+#ifndef CRYPTOPP_THREAD_H
+#define CRYPTOPP_THREAD_H
+
+#include "cryptlib.h"
+
+NAMESPACE_BEGIN(CryptoPP)
+
+// a piece of work to be done by a WorkerThread
+class WorkerTask
+{
+public:
+	virtual ~WorkerTask() {}
+	virtual void Run() =0;
+};
+
+// runs a WorkerTask on a thread of its own, if THREADS_AVAILABLE is defined
+// and the system can create one, otherwise on the calling thread in Join()
+class WorkerThread
+{
+public:
+	class Err : public Exception
+	{
+	public:
+		Err(const std::string &s) : Exception(s) {}
+	};
+
+	WorkerThread(WorkerTask &task);
+	// waits for the thread, if one was started
+	~WorkerThread();
+
+	// waits for the task to finish, and rethrows an exception that the task threw, as one of
+	// the same type for the types listed in thread.cpp, as an Exception with the same message
+	// for other Exceptions, and as Err for anything else
+	void Join();
+
+	// these are used by the thread itself
+	void Execute();
+	struct Handle;
+	class Failure;
+
+private:
+	WorkerThread(const WorkerThread &);		// not copyable
+	void operator=(const WorkerThread &);
+
+	WorkerTask &m_task;
+	Handle *m_handle;	// NULL if the task runs on the calling thread
+	Failure *m_failure;	// a copy of the exception the task threw, or NULL
+	bool m_done;
+};
+
+// a lock that one thread at a time can hold, Lock() and Unlock() do nothing
+// if THREADS_AVAILABLE isn't defined
+class Mutex
+{
+public:
+	Mutex();
+	~Mutex();
+
+	void Lock();
+	void Unlock();
+
+	struct Handle;
+
+private:
+	Mutex(const Mutex &);		// not copyable
+	void operator=(const Mutex &);
+
+	Handle *m_handle;
+};
+
+// holds a Mutex from its construction to its destruction
+class MutexLock
+{
+public:
+	MutexLock(Mutex &mutex) : m_mutex(mutex) {m_mutex.Lock();}
+	~MutexLock() {m_mutex.Unlock();}
+
+private:
+	MutexLock(const MutexLock &);		// not copyable
+	void operator=(const MutexLock &);
+
+	Mutex &m_mutex;
+};
+
+// runs tasks[0..count), the last one on the calling thread and the others on
+// WorkerThreads, and returns once they have all finished
+void RunWorkerTasks(WorkerTask *const *tasks, unsigned int count);
+
+// the work on a batch of elements, which RunBatch() divides among threads
+class BatchProcessor
+{
+public:
+	virtual ~BatchProcessor() {}
+	// processes elements [begin, begin+count), called from several threads at the same time
+	virtual void ProcessBatch(unsigned int begin, unsigned int count) const =0;
+};
+
+// divides count elements into threadCount runs of nearly equal size, or count runs if
+// that is fewer, and processes them on as many threads, including the calling one
+void RunBatch(const BatchProcessor &processor, unsigned int count, unsigned int threadCount);
+
+NAMESPACE_END
+
+#endif
@@ -77,6 +77,7 @@ bool ValidateAll()
 	pass=TwofishValidate() && pass;
 	pass=SerpentValidate() && pass;
 
+	pass=IntegerValidate() && pass;
 	pass=BBSValidate() && pass;
 	pass=DHValidate() && pass;
 	pass=MQVValidate() && pass;
@@ -93,6 +94,7 @@ bool ValidateAll()
 	pass=ECPValidate() && pass;
 	pass=EC2NValidate() && pass;
 	pass=ECDSAValidate() && pass;
+	pass=DisperseValidate() && pass;
 
 	if (pass)
 		cout << "\nAll tests passed!\n";
@@ -2,6 +2,8 @@
 
 #include "pch.h"
 
+#include "modarith.h"
+#include "nbtheory.h"
 #include "blumshub.h"
 #include "rsa.h"
 #include "md2.h"
@@ -17,15 +19,20 @@
 #include "eccrypto.h"
 #include "ecp.h"
 #include "ec2n.h"
+#include "pool.h"
 // #include "zeroknow.h"
 #include "asn.h"
 #include "rng.h"
 #include "files.h"
 #include "hex.h"
 #include "forkjoin.h"
+#include "secshare.h"
+#include "thread.h"
 
+#include <time.h>
 #include <iostream>
 #include <iomanip>
+#include <strstream>
 
 #include "validate.h"
 
@@ -48,6 +55,352 @@ private:
 	BufferedTransformation &m_source;
 };
 
+// times BatchVerifyDigests() against VerifyDigest() on each signature under a precomputed key,
+// whose tables the batch should use rather than build its own
+template <class V>
+bool BatchVerificationSpeedValidate(const DigestSigner &priv, const V &pub)
+{
+	const unsigned int count = 32, digestLen = 20, trials = 9;
+	const unsigned int sigLen = pub.DigestSignatureLength();
+	LC_RNG rng(5168);
+	V key(pub);
+	key.Precompute();
+	SecByteBlock digests(count*digestLen), signatures(count*sigLen);
+	const V *keys[count];
+	const byte *digestPtrs[count], *signaturePtrs[count];
+	unsigned int digestLens[count];
+	unsigned int i, t;
+
+	for (i=0; i<count; i++)
+	{
+		rng.GetBlock(digests+i*digestLen, digestLen);
+		priv.SignDigest(rng, digests+i*digestLen, digestLen, signatures+i*sigLen);
+		keys[i] = &key;
+		digestPtrs[i] = digests+i*digestLen;
+		digestLens[i] = digestLen;
+		signaturePtrs[i] = signatures+i*sigLen;
+	}
+
+	bool fail = false;
+	clock_t loopTime = 0, batchTime = 0;
+	for (t=0; t<trials; t++)
+	{
+		clock_t start = clock();
+		for (i=0; i<count; i++)
+			fail = fail || !key.VerifyDigest(digestPtrs[i], digestLens[i], signaturePtrs[i]);
+		const clock_t loop = clock() - start;
+
+		start = clock();
+		fail = fail || !BatchVerifyDigests(count, keys, digestPtrs, digestLens, signaturePtrs);
+		const clock_t batch = clock() - start;
+
+		loopTime = t ? STDMIN(loopTime, loop) : loop;
+		batchTime = t ? STDMIN(batchTime, batch) : batch;
+	}
+	// the fastest of several trials, with a tenth and a clock tick to spare for timer noise
+	fail = fail || batchTime > loopTime + loopTime/10 + 1;
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "batch verification no slower than one at a time with a precomputed key\n";
+	return !fail;
+}
+
+// checks BatchVerifyDigests() against a batch with one corrupted signature
+template <class V>
+bool BatchVerificationValidate(const DigestSigner &priv, const V &pub)
+{
+	const unsigned int count = 10, digestLen = 20, corrupt = 3;
+	const unsigned int sigLen = pub.DigestSignatureLength();
+	LC_RNG rng(5167);
+	SecByteBlock digests(count*digestLen), signatures(count*sigLen);
+	const V *keys[count];
+	const byte *digestPtrs[count], *signaturePtrs[count];
+	unsigned int digestLens[count];
+	bool valid[count];
+	unsigned int i;
+
+	for (i=0; i<count; i++)
+	{
+		rng.GetBlock(digests+i*digestLen, digestLen);
+		priv.SignDigest(rng, digests+i*digestLen, digestLen, signatures+i*sigLen);
+		keys[i] = &pub;
+		digestPtrs[i] = digests+i*digestLen;
+		digestLens[i] = digestLen;
+		signaturePtrs[i] = signatures+i*sigLen;
+	}
+
+	bool fail = !BatchVerifyDigests(count, keys, digestPtrs, digestLens, signaturePtrs, valid);
+	for (i=0; i<count; i++)
+		fail = fail || !valid[i];
+
+	signatures[corrupt*sigLen+sigLen-1] ^= 1;
+	fail = fail || BatchVerifyDigests(count, keys, digestPtrs, digestLens, signaturePtrs, valid);
+	for (i=0; i<count; i++)
+		fail = fail || valid[i] != (i != corrupt);
+
+	// too few to pay for batch tables
+	fail = fail || !BatchVerifyDigests(2, keys, digestPtrs, digestLens, signaturePtrs);
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "batch verification\n";
+	return BatchVerificationSpeedValidate(priv, pub) && !fail;
+}
+
+// signs with nonces from a pool, and after it has run dry, then checks the pool's counts
+template <class S>
+bool NoncePoolValidate(S &priv, const DigestVerifier &pub)
+{
+	const unsigned int count = 12, capacity = 4, digestLen = 20;
+	LC_RNG rng(6213);
+	byte digest[digestLen];
+	SecByteBlock signature(pub.DigestSignatureLength());
+	bool fail = false;
+
+	priv.StartNoncePool(new LC_RNG(6214), capacity);
+	for (unsigned int i=0; i<count; i++)
+	{
+		rng.GetBlock(digest, digestLen);
+		priv.SignDigest(rng, digest, digestLen, signature);
+		fail = fail || !pub.VerifyDigest(digest, digestLen, signature);
+	}
+
+	PrecomputedPoolStatistics statistics = priv.GetNoncePoolStatistics();
+	fail = fail || statistics.taken + statistics.missed != count || statistics.capacity != capacity
+		|| statistics.size > capacity || statistics.generated < statistics.taken + statistics.size;
+	priv.StopNoncePool();
+	fail = fail || priv.GetNoncePoolStatistics().capacity != 0;
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "signing with a nonce pool\n";
+	return !fail;
+}
+
+// copies the precomputation of source to dest through an image, after checking that a truncated
+// one and one whose first element has a coordinate outside the field are refused
+template <class S, class D>
+bool PrecomputationImageValidate(const S &source, D &dest)
+{
+	ByteQueue queue;
+	source.SavePrecomputationImage(queue);
+	SecByteBlock image(queue.MaxRetrieveable());
+	queue.Get(image, image.size);
+
+	// header field 3 is the coordinate size and field 5 the size of exponentBase,
+	// which comes before the modulus and then the first element
+	word32 header[8];
+	GetUserKeyBigEndian(header, 8, image, 32);
+	const unsigned int coordinateSize = header[3], first = 32 + header[5] + coordinateSize;
+	SecByteBlock corrupt(image.size);
+	memcpy(corrupt, image, image.size);
+	memset(corrupt+first, 0xff, coordinateSize);
+
+	bool fail = false;
+	try
+	{
+		dest.LoadPrecomputationImage(image, image.size-1);
+		fail = true;
+	}
+	catch (InvalidPrecomputationImage &)
+	{
+	}
+	try
+	{
+		dest.LoadPrecomputationImage(corrupt, corrupt.size);
+		fail = true;
+	}
+	catch (InvalidPrecomputationImage &)
+	{
+	}
+	fail = fail || dest.LoadPrecomputationImage(image, image.size) != image.size;
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "precomputation image round trip\n";
+	return !fail;
+}
+
+// checks Multiply() and Square() against a*b%m, with operands that fill the register of the modulus,
+// so most of them are not reduced
+static bool ModularMultiplicationValidate(const Integer &m, ModularArithmetic::ReductionMethod method)
+{
+	static const char *const methodNames[] = {"automatic", "division", "Barrett", "special form"};
+	LC_RNG rng(4519);
+	ModularArithmetic ma(m, method);
+	const Integer bound = Integer::Power2(m.WordCount()*WORD_BITS) - 1;
+	// AUTOMATIC starts with a long division for moduli without a special form, and sets up
+	// Barrett reduction before this test's 66 reductions are done
+	const bool automaticBarrett = method == ModularArithmetic::AUTOMATIC && !ModularArithmetic::HasSpecialForm(m);
+	bool fail = automaticBarrett && ma.GetReductionMethod() != ModularArithmetic::DIVISION;
+
+	for (unsigned int i=0; i<32 && !fail; i++)
+	{
+		Integer a(rng, Integer::Zero(), i%4 ? bound : m-1);
+		Integer b(rng, Integer::Zero(), i%2 ? bound : m-1);
+		fail = ma.Multiply(a, b) != a*b%m || ma.Square(a) != a.Squared()%m;
+	}
+	fail = fail || ma.Multiply(m, m-1) != Integer::Zero() || ma.Square(bound) != bound.Squared()%m;
+	fail = fail || (automaticBarrett && ma.GetReductionMethod() != ModularArithmetic::BARRETT);
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << m.BitCount() << "-bit modulus, " << methodNames[method] << " reduction\n";
+	return !fail;
+}
+
+// generates primes on one thread and on four, one thread must find the prime that a search
+// from a single random starting point finds
+static bool PrimeSearchValidate()
+{
+	const unsigned int threadCount = GetPrimeSearchThreadCount();
+	const Integer min = Integer::Power2(511), max = Integer::Power2(512)-1;
+	Integer p[2], q[2], r[2];
+	bool fail = false;
+
+	for (unsigned int i=0; i<2; i++)
+	{
+		SetPrimeSearchThreadCount(i ? 4 : 1);
+		LC_RNG rng(2946);
+		p[i] = Integer(rng, min, max, Integer::PRIME);
+		q[i] = MaurerProvablePrime(rng, 384);
+		r[i] = MihailescuProvablePrime(rng, 384);
+		fail = fail || !IsPrime(p[i]) || !IsPrime(q[i]) || !IsPrime(r[i])
+			|| p[i].BitCount() != 512 || q[i].BitCount() != 384 || r[i].BitCount() != 384;
+	}
+	SetPrimeSearchThreadCount(threadCount);
+
+	LC_RNG rng(2946);
+	Integer s(rng, min, max);
+	fail = fail || !FirstPrime(s, STDMIN(s+PrimeSearchInterval(max), max), Integer::Zero(), Integer::One()) || s != p[0];
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "prime search on 1 and 4 threads\n";
+	return !fail;
+}
+
+// writes x with operator<< in the given base and reads it back with Integer(const char *)
+static bool TextRoundTrip(const Integer &x, std::ios::fmtflags base)
+{
+	ostrstream out;
+	out.setf(base, std::ios::basefield);
+	out << x << ends;
+	bool pass = Integer(out.str()) == x;
+	out.freeze(false);
+	return pass;
+}
+
+// operator<< has no binary base, so this writes the bits out one by one
+static bool BinaryRoundTrip(const Integer &x)
+{
+	string text = x.IsNegative() ? "-" : "";
+	for (unsigned int i=x.BitCount(); i--; )
+		text += char('0' + x.GetBit(i));
+	return Integer((text + 'b').c_str()) == x;
+}
+
+static string DecimalText(const Integer &x)
+{
+	ostrstream out;
+	out << x << ends;
+	string text = out.str();
+	out.freeze(false);
+	return text;
+}
+
+// the sizes straddle the leaf size of the decimal splitting and the Toom-3 and NTT thresholds
+// of 1024 and 8192 words, which the splitting reaches at half the size of the number
+static bool TextConversionValidate()
+{
+	static const unsigned int bits[] = {1, 2, WORD_BITS-1, WORD_BITS, WORD_BITS+1, 900, 1100, 5000,
+		1024*WORD_BITS+1, 2048*WORD_BITS+1, 8192*WORD_BITS+1, 16384*WORD_BITS+1, 20000*WORD_BITS};
+	LC_RNG rng(3157);
+	bool decimalFail = false, binaryFail = false;
+
+	for (unsigned int i=0; i<sizeof(bits)/sizeof(bits[0]); i++)
+	{
+		const Integer x(rng, bits[i]), ones = Integer::Power2(bits[i])-1;
+		decimalFail = decimalFail || !TextRoundTrip(x, std::ios::dec) || !TextRoundTrip(-x, std::ios::dec) || !TextRoundTrip(ones, std::ios::dec);
+		binaryFail = binaryFail || !TextRoundTrip(x, std::ios::hex) || !TextRoundTrip(-x, std::ios::hex) || !TextRoundTrip(ones, std::ios::hex)
+			|| !TextRoundTrip(x, std::ios::oct) || !TextRoundTrip(ones, std::ios::oct) || !BinaryRoundTrip(x) || !BinaryRoundTrip(-x);
+
+		// 10^k-1 and 10^k fill every chunk with nines and zeros
+		const string nines(bits[i]*3/10+1, '9'), power = "1" + string(nines.size(), '0');
+		const Integer n(nines.c_str());
+		decimalFail = decimalFail || n+1 != Integer(power.c_str()) || DecimalText(n) != nines + '.' || DecimalText(n+1) != power + '.';
+	}
+
+	cout << (decimalFail ? "FAILED    " : "passed    ");
+	cout << "decimal text conversion\n";
+	cout << (binaryFail ? "FAILED    " : "passed    ");
+	cout << "hexadecimal, octal and binary text conversion\n";
+	return !decimalFail && !binaryFail;
+}
+
+class DivisionTask : public WorkerTask
+{
+public:
+	DivisionTask(const Integer &divisor) : m_divisor(divisor) {}
+	void Run() {Integer::One() / m_divisor;}
+
+private:
+	Integer m_divisor;
+};
+
+// an exception thrown by a task on a worker thread must reach the caller with its type
+static bool WorkerExceptionValidate()
+{
+	// RunWorkerTasks() runs the first task on a worker thread and the last on this one
+	DivisionTask task0(Integer::Zero()), task1(Integer::One());
+	WorkerTask *tasks[] = {&task0, &task1};
+	bool fail = true;
+
+	try
+	{
+		RunWorkerTasks(tasks, 2);
+	}
+	catch (const Integer::DivideByZero &)
+	{
+		fail = false;
+	}
+	catch (const Exception &)
+	{
+	}
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "Integer::DivideByZero thrown on a worker thread\n";
+	return !fail;
+}
+
+bool IntegerValidate()
+{
+	cout << "\nInteger validation suite running...\n\n";
+
+	LC_RNG rng(4520);
+	bool pass = true;
+
+	static const unsigned int bits[] = {100, 250, 500, 1000};
+	for (unsigned int i=0; i<sizeof(bits)/sizeof(bits[0]); i++)
+	{
+		Integer m(rng, Integer::Power2(bits[i]-1), Integer::Power2(bits[i])-1);
+		pass = ModularMultiplicationValidate(m, ModularArithmetic::DIVISION) && pass;
+		pass = ModularMultiplicationValidate(m, ModularArithmetic::BARRETT) && pass;
+	}
+	pass = ModularMultiplicationValidate(Integer(rng, Integer::Power2(499), Integer::Power2(500)-1), ModularArithmetic::AUTOMATIC) && pass;
+	pass = ModularMultiplicationValidate(Integer::Power2(255)-19, ModularArithmetic::AUTOMATIC) && pass;
+
+	pass = ModularMultiplicationValidate(Integer::Power2(255)-19, ModularArithmetic::SPECIAL_FORM) && pass;
+	pass = ModularMultiplicationValidate(Integer::Power2(521)-1, ModularArithmetic::SPECIAL_FORM) && pass;
+
+	// the NIST primes P-192, P-224, P-256 and P-384
+	pass = ModularMultiplicationValidate(Integer::Power2(192)-Integer::Power2(64)-1, ModularArithmetic::SPECIAL_FORM) && pass;
+	pass = ModularMultiplicationValidate(Integer::Power2(224)-Integer::Power2(96)+1, ModularArithmetic::SPECIAL_FORM) && pass;
+	pass = ModularMultiplicationValidate(Integer::Power2(256)-Integer::Power2(224)+Integer::Power2(192)+Integer::Power2(96)-1, ModularArithmetic::SPECIAL_FORM) && pass;
+	pass = ModularMultiplicationValidate(Integer::Power2(384)-Integer::Power2(128)-Integer::Power2(96)+Integer::Power2(32)-1, ModularArithmetic::SPECIAL_FORM) && pass;
+
+	pass = PrimeSearchValidate() && pass;
+	pass = TextConversionValidate() && pass;
+	pass = WorkerExceptionValidate() && pass;
+
+	return pass;
+}
+
 bool BBSValidate()
 {
 	cout << "\nBlumBlumShub validation suite running...\n\n";
@@ -97,6 +450,26 @@ bool BBSValidate()
 		cout << setw(2) << setfill('0') << hex << (int)buf[j];
 	cout << endl;
 
+	// the public generator squares mod n, and mixes bit and byte requests
+	PublicBlumBlumShub pub(p*q, seed);
+	BlumBlumShub priv(p, q, seed);
+	SecByteBlock pubBuf(1000), privBuf(1000);
+	for (j=0; j<10; j++)
+	{
+		pubBuf[j] = 0;
+		for (int k=0; k<8; k++)
+			pubBuf[j] = (pubBuf[j] << 1) | pub.GetBit();
+	}
+	for (j=10; j<20; j++)
+		pubBuf[j] = pub.GetByte();
+	pub.GetBlock(pubBuf+20, 980);
+	priv.GetBlock(privBuf, 1000);
+	fail = memcmp(pubBuf, privBuf, 1000) != 0;
+	pass = pass && !fail;
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "public and CRT generators agree\n";
+
 	return pass;
 }
 
@@ -274,6 +647,28 @@ bool RSAValidate()
 
 			pass = CryptoSystemValidate(rsaPriv, rsaPub) && pass;
 		}
+		{
+			FileSource keys("rsa512.dat", true, new HexDecoder);
+			InvertibleRSAFunction rsa(keys);
+			LC_RNG rng(5678);
+
+			Integer x[7], y[7];
+			unsigned int i;
+			for (i=0; i<7; i++)
+				x[i].Randomize(rng, Integer::Zero(), rsa.MaxImage());
+
+			rsa.CalculateInverses(y, x, 7, 3);
+			fail = false;
+			for (i=0; i<7; i++)
+				fail = fail || rsa.ApplyFunction(y[i]) != x[i];
+
+			rsa.SetParallelCRT(true);
+			fail = fail || rsa.CalculateInverse(x[0]) != y[0];
+			pass = pass && !fail;
+
+			cout << (fail ? "FAILED    " : "passed    ");
+			cout << "batch and parallel CRT inversion\n";
+		}
 		{
 			byte *plain = (byte *)
 				"\x54\x85\x9b\x34\x2c\x49\xea\x2a";
@@ -314,13 +709,35 @@ bool RSAValidate()
 	return pass;
 }
 
+// runs validate on a domain wrapped in a filled key pair pool, then checks the pool's counts
+template <class P, class D>
+bool KeyPairPoolValidate(P &pooled, bool (*validate)(D &))
+{
+	pooled.FillKeyPairPool();
+	bool pass = validate(pooled);
+
+	PrecomputedPoolStatistics statistics = pooled.GetKeyPairPoolStatistics();
+	bool fail = statistics.taken != 2 || statistics.missed != 0 || statistics.size > statistics.capacity;
+	pass = pass && !fail;
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "key pairs from a pool\n";
+	return pass;
+}
+
 bool DHValidate()
 {
 	cout << "\nDH validation suite running...\n\n";
 
 	FileSource f("dh512.dat", true, new HexDecoder());
 	DH dh(f);
-	return SimpleKeyAgreementValidate(dh);
+	FileSource fp("dh512.dat", true, new HexDecoder());
+	DH precomputed(fp);
+	precomputed.Precompute();
+	bool pass = PrecomputationImageValidate(precomputed, dh);
+	pass = SimpleKeyAgreementValidate(dh) && pass;
+	PooledSimpleKeyAgreementDomain pooled(dh, new LC_RNG(5236), 4);
+	return KeyPairPoolValidate(pooled, SimpleKeyAgreementValidate) && pass;
 }
 
 bool MQVValidate()
@@ -329,7 +746,9 @@ bool MQVValidate()
 
 	FileSource f("mqv512.dat", true, new HexDecoder());
 	MQV mqv(f);
-	return AuthenticatedKeyAgreementValidate(mqv);
+	bool pass = AuthenticatedKeyAgreementValidate(mqv);
+	PooledAuthenticatedKeyAgreementDomain pooled(mqv, new LC_RNG(5237), 4);
+	return KeyPairPoolValidate(pooled, AuthenticatedKeyAgreementValidate) && pass;
 }
 
 bool LUCDIFValidate()
@@ -338,7 +757,9 @@ bool LUCDIFValidate()
 
 	FileSource f("lucdif.dat", true, new HexDecoder());
 	LUCDIF dh(f);
-	return SimpleKeyAgreementValidate(dh);
+	bool pass = SimpleKeyAgreementValidate(dh);
+	PooledSimpleKeyAgreementDomain pooled(dh, new LC_RNG(5238), 4);
+	return KeyPairPoolValidate(pooled, SimpleKeyAgreementValidate) && pass;
 }
 
 bool ElGamalValidate()
@@ -383,6 +804,8 @@ bool NRValidate()
 		NRVerifier<SHA> pubS(privS);
 
 		pass = SignatureValidate(privS, pubS) && pass;
+		pass = BatchVerificationValidate<NRDigestVerifier>(privS, pubS) && pass;
+		pass = NoncePoolValidate(privS, pubS) && pass;
 	}
 	return pass;
 }
@@ -439,7 +862,10 @@ bool DSAValidate()
 	DSAPrivateKey priv(fs);
 	priv.LoadPrecomputation(fs);
 	DSAPublicKey pub(priv);
+	pass = PrecomputationImageValidate(priv, pub) && pass;
 	pass = SignatureValidate(priv, pub) && pass;
+	pass = BatchVerificationValidate<GDSADigestVerifier>(priv, pub) && pass;
+	pass = NoncePoolValidate(priv, pub) && pass;
 	return pass;
 }
 
@@ -460,6 +886,26 @@ bool LUCValidate()
 		LUCES_OAEP_SHA_Encryptor pub(priv);
 		pass = CryptoSystemValidate(priv, pub) && pass;
 	}
+	{
+		FileSource f("luc512.dat", true, new HexDecoder);
+		InvertibleLUCFunction luc(f);
+		LC_RNG rng(5678);
+
+		Integer x[7], y[7], z[7];
+		unsigned int i;
+		for (i=0; i<7; i++)
+			x[i].Randomize(rng, Integer::Zero(), luc.MaxImage());
+
+		luc.CalculateInverses(y, x, 7, 3);
+		luc.ApplyFunctions(z, y, 7, 2);
+		bool fail = false;
+		for (i=0; i<7; i++)
+			fail = fail || z[i] != x[i] || luc.CalculateInverse(x[i]) != y[i];
+		pass = pass && !fail;
+
+		cout << (fail ? "FAILED    " : "passed    ");
+		cout << "batch evaluation and inversion\n";
+	}
 	return pass;
 }
 
@@ -552,10 +998,44 @@ bool ECPValidate()
 	pub.LoadPrecomputation(queue);
 
 	bool pass = SignatureValidate(priv, pub);
+	pass = BatchVerificationValidate<ECPublicKey<ECP> >(priv, pub) && pass;
 	pass = CryptoSystemValidate(priv, pub) && pass;
 	pass = SimpleKeyAgreementValidate(ecdhc) && pass;
 	pass = AuthenticatedKeyAgreementValidate(ecmqvc) && pass;
 
+	for (int i=ECPNamedCurve::P192; i<=ECPNamedCurve::P521; i++)
+	{
+		ECPNamedCurve curve((ECPNamedCurve::ID)i);
+		const ECP &ecn = curve.GetCurve();
+		const ECP::Point &G = curve.GetBasePoint();
+
+		bool fail = !ecn.VerifyPoint(G) || !ecn.Multiply(curve.GetBasePointOrder(), G).identity
+			|| ECPNamedCurve(curve.GetName()).GetID() != curve.GetID();
+		pass = pass && !fail;
+
+		cout << (fail ? "FAILED    " : "passed    ");
+		cout << curve.GetName() << " base point and order\n";
+
+		// a decoded point may have coordinates that are not reduced
+		ECP::Point U(G.x + ecn.FieldSize(), G.y + ecn.FieldSize());
+		fail = !ecn.Equal(ecn.Multiply(d, U), ecn.Multiply(d, G))
+			|| !ecn.Equal(ecn.CascadeMultiply(d, U, k, G), ecn.CascadeMultiply(d, G, k, G));
+		pass = pass && !fail;
+
+		cout << (fail ? "FAILED    " : "passed    ");
+		cout << curve.GetName() << " multiplication of unreduced point\n";
+	}
+
+	ECPNamedCurve p256(ECPNamedCurve::P256);
+	Integer d256("0x1f2e3d4c5b6a79881f2e3d4c5b6a79881f2e3d4c5b6a79881f2e3d4c5b6a7988");
+	ECSigner<ECP, SHA, ECDSA> priv256(p256.GetCurve(), p256.GetBasePoint(),
+		p256.GetCurve().Multiply(d256, p256.GetBasePoint()), p256.GetBasePointOrder(), d256);
+	ECVerifier<ECP, SHA, ECDSA> pub256(priv256);
+	priv256.Precompute();
+	pass = PrecomputationImageValidate(priv256, pub256) && pass;
+	pass = SignatureValidate(priv256, pub256) && pass;
+	pass = NoncePoolValidate(priv256, pub256) && pass;
+
 	return pass;
 }
 
@@ -578,12 +1058,41 @@ bool EC2NValidate()
 	ECDHC<EC2N> ecdhc(ec, P, r, k);
 	ECMQVC<EC2N> ecmqvc(ec, P, r, k);
 
-	priv.Precompute();
+	// saved precomputations for P and Q of one point whose coordinates have degree 159,
+	// so aren't elements of GF(2^155)
+	const unsigned int size = gf2n.MaxElementByteLength();
+	SecByteBlock coordinates(2*size);
+	memset(coordinates, 0xff, coordinates.size);
 	ByteQueue queue;
+	for (unsigned int i=0; i<2; i++)
+	{
+		DERSequenceEncoder corrupt(queue);
+		Integer::One().DEREncode(corrupt);
+		Integer(2).DEREncode(corrupt);
+		corrupt.Put(coordinates, coordinates.size);
+		corrupt.InputFinished();
+	}
+
+	bool fail = true;
+	try
+	{
+		pub.LoadPrecomputation(queue);
+	}
+	catch (BERDecodeErr &)
+	{
+		fail = false;
+	}
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "precomputation with a point outside the field\n";
+
+	priv.Precompute();
+	queue.Clear();
 	priv.SavePrecomputation(queue);
 	pub.LoadPrecomputation(queue);
 
-	bool pass = SignatureValidate(priv, pub);
+	bool pass = PrecomputationImageValidate(priv, pub) && !fail;
+	pass = SignatureValidate(priv, pub) && pass;
+	pass = NoncePoolValidate(priv, pub) && pass;
 	pass = CryptoSystemValidate(priv, pub) && pass;
 	pass = SimpleKeyAgreementValidate(ecdhc) && pass;
 	pass = AuthenticatedKeyAgreementValidate(ecmqvc) && pass;
@@ -636,6 +1145,64 @@ bool ECDSAValidate()
 	pass = pass && !fail;
 
 	pass = SignatureValidate(priv, pub) && pass;
+	pass = BatchVerificationValidate<ECPublicKey<EC2N, ECDSA> >(priv, pub) && pass;
+
+	return pass;
+}
+
+// splits data with DisperseFork and joins the last m of the n shares, in reverse order
+static bool DisperseRoundTrip(unsigned int m, unsigned int n, DisperseFork::Format format, const byte *data, unsigned int length)
+{
+	DisperseFork fork(m, n, NULL, format);
+	fork.Put(data, length/3);
+	fork.Put(data+length/3, length-length/3);
+	fork.Close();
+
+	DisperseJoin join(m);
+	vector_member_ptrs<JoinInterface> ports(m);
+	unsigned int i;
+	for (i=0; i<m; i++)
+	{
+		ports[i].reset(join.ReleaseInterface(i));
+		fork.SelectOutPort(n-1-i);
+		fork.TransferTo(*ports[i]);
+	}
+	for (i=0; i<m; i++)
+		ports[i]->Close();
+
+	SecByteBlock output(length+1);
+	return join.MaxRetrieveable() == length && join.Get(output, length+1) == length && memcmp(output, data, length) == 0;
+}
+
+bool DisperseValidate()
+{
+	cout << "\nInformation dispersal validation suite running...\n\n";
+
+	static const char *const formatNames[] = {"GF(2^32)", "GF(2^8)"};
+	static const unsigned int lengths[] = {0, 1, 2, 4095, 12289, 3*DisperseFork::GF256_ROW_LENGTH, 100001};
+	LC_RNG rng(7291);
+	SecByteBlock data(100001);
+	rng.GetBlock(data, data.size);
+	bool pass = true;
+
+	for (int format=DisperseFork::GF2_32_FORMAT; format<=DisperseFork::GF256_FORMAT; format++)
+	{
+		bool fail = false;
+		for (unsigned int i=0; i<sizeof(lengths)/sizeof(lengths[0]); i++)
+			fail = !DisperseRoundTrip(3, 5, (DisperseFork::Format)format, data, lengths[i])
+				|| !DisperseRoundTrip(1, 2, (DisperseFork::Format)format, data, lengths[i]) || fail;
+		pass = pass && !fail;
+
+		cout << (fail ? "FAILED    " : "passed    ");
+		cout << formatNames[format] << " round trips\n";
+	}
+
+	// more than 255 shares fall back to the GF(2^32) format
+	bool fail = !DisperseRoundTrip(2, 300, DisperseFork::GF256_FORMAT, data, 1001);
+	pass = pass && !fail;
+
+	cout << (fail ? "FAILED    " : "passed    ");
+	cout << "300 shares\n";
 
 	return pass;
 }
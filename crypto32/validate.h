@@ -41,6 +41,7 @@ bool RijndaelValidate();
 bool TwofishValidate();
 bool SerpentValidate();
 
+bool IntegerValidate();
 bool BBSValidate();
 bool DHValidate();
 bool MQVValidate();
@@ -57,5 +58,6 @@ bool BlumGoldwasserValidate();
 bool ECPValidate();
 bool EC2NValidate();
 bool ECDSAValidate();
+bool DisperseValidate();
 
 #endif